@@ -0,0 +1,145 @@
+#ifndef VEC_ARENA_H
+#define VEC_ARENA_H
+
+#include <cstddef> // size_t
+#include <cassert>
+#include <type_traits>
+#include <vector>
+
+#include "Vector3SoA.h" // AlignedAlloc, SoAAlignment
+
+// ************************************************************************************
+// Arena class - Bump allocator for transient buffers.
+//
+// Allocation moves an offset through a list of blocks; nothing is freed
+// individually. Reset (or leaving an Arena::Scope) rewinds the offset but
+// keeps the blocks, so once a frame's peak has been reached later frames
+// allocate nothing from the heap. Every allocation is aligned to
+// SoAAlignment by default, enough for Vector3A and every SIMD load. An
+// Arena is not thread-safe; use one per thread.
+//
+// ************************************************************************************
+//
+namespace Vec
+{
+	class Arena
+	{
+	public:
+		// Default alignment of allocations.
+		//
+		static const size_t Alignment = SoAAlignment;
+
+		// A position to rewind to.
+		//
+		struct Marker {size_t block, offset;};
+
+		// Releases everything allocated after it was constructed when it goes
+		// out of scope, e.g. once per frame.
+		//
+		class Scope
+		{
+		public:
+			explicit Scope (Arena& arena) : arena(arena), mark(arena.Mark ()) {}
+			~Scope () {arena.Release (mark);}
+
+		private:
+			Scope (Scope const&);
+			Scope& operator= (Scope const&);
+
+			Arena& arena;
+			Marker mark;
+		};
+
+		// Blocks are at least blockSize bytes; larger requests get a block of
+		// their own size.
+		//
+		explicit Arena (size_t blockSize = size_t(1) << 20) : blockSize(blockSize), current(0), offset(0) {}
+		~Arena () {for (size_t i = 0; i < blocks.size (); ++i) AlignedFree (blocks[i].data);}
+
+		// n bytes aligned to align (a power of two, at most Alignment);
+		// throws std::bad_alloc when the heap is exhausted.
+		//
+		void* Allocate (size_t n, size_t align = Alignment) {
+			assert (align && (align & (align - 1)) == 0 && align <= Alignment);
+			for (;; ++current, offset = 0) {
+				if (current == blocks.size ()) {
+					Block b = {static_cast<char*> (AlignedAlloc (n > blockSize ? n : blockSize, Alignment)), n > blockSize ? n : blockSize};
+					blocks.push_back (b); }
+				size_t o = (offset + align - 1) & ~(align - 1);
+				if (o + n <= blocks[current].size) {
+					offset = o + n;
+					return blocks[current].data + o; } } }
+
+		// Uninitialized storage for n objects of a trivially destructible type.
+		//
+		template <class T>
+		T* Allocate (size_t n) {
+			static_assert (std::is_trivially_destructible<T>::value, "Arena never runs destructors");
+			static_assert (alignof (T) <= Alignment, "Over-aligned type");
+			return static_cast<T*> (Allocate (n * sizeof (T))); }
+
+		// Rewinding.
+		//
+		Marker Mark () const {Marker m = {current, offset}; return m;}
+		void Release (Marker const& m) {current = m.block; offset = m.offset;}
+		void Reset () {current = 0; offset = 0;}
+
+		// Bytes handed out since the last Reset (including alignment padding
+		// and the unused tails of skipped blocks), and bytes held.
+		//
+		size_t Used () const {
+			size_t u = offset;
+			for (size_t i = 0; i < current && i < blocks.size (); ++i) u += blocks[i].size;
+			return u; }
+		size_t Capacity () const {
+			size_t c = 0;
+			for (size_t i = 0; i < blocks.size (); ++i) c += blocks[i].size;
+			return c; }
+
+	private:
+		Arena (Arena const&);
+		Arena& operator= (Arena const&);
+
+		struct Block {char* data; size_t size;};
+
+		size_t blockSize;
+		std::vector<Block> blocks;
+		size_t current, offset;
+	};
+
+
+	// ************************************************************************************
+	// ArenaAllocator class - STL allocator drawing from an Arena.
+	//
+	// deallocate does nothing; the memory comes back when the arena is
+	// rewound, so a container must not outlive the Scope it was filled in.
+	//
+	// ************************************************************************************
+	//
+	template <class T>
+	class ArenaAllocator
+	{
+	public:
+		typedef T value_type;
+
+		ArenaAllocator (Arena& arena) : arena(&arena) {}
+		template <class U> ArenaAllocator (ArenaAllocator<U> const& a) : arena(a.arena) {}
+
+		T* allocate (size_t n) {return static_cast<T*> (arena->Allocate (n * sizeof (T)));}
+		void deallocate (T*, size_t) {}
+
+		template <class U> bool operator== (ArenaAllocator<U> const& a) const {return arena == a.arena;}
+		template <class U> bool operator!= (ArenaAllocator<U> const& a) const {return arena != a.arena;}
+
+	private:
+		template <class U> friend class ArenaAllocator;
+
+		Arena* arena;
+	};
+
+	// A std::vector in an arena.
+	//
+	template <class T> using ArenaVector = std::vector<T, ArenaAllocator<T> >;
+}
+
+#endif // VEC_ARENA_H
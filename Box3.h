@@ -0,0 +1,77 @@
+#ifndef BOX3_H
+#define BOX3_H
+
+#include <limits>
+
+#include "Vector3.h"
+
+// ************************************************************************************
+// Box3T structure - Axis-aligned bounding box of Vector3T points.
+//
+//
+// ************************************************************************************
+//
+namespace Vec
+{
+	namespace detail
+	{
+		// Component a (0, 1, 2) of a vector.
+		//
+		template <class T> inline T axis (Vector3T<T> const& v, int a) {return a == 0 ? v.x : (a == 1 ? v.y : v.z);}
+	}
+
+	template <class T>
+	struct Box3T
+	{
+		Vector3T<T> min, max;
+
+		// Constructors.
+		//
+		Box3T () = default;
+		constexpr Box3T (Vector3T<T> const& min, Vector3T<T> const& max) : min(min), max(max) {}
+
+		// The box containing nothing; extending it by a point gives that point.
+		//
+		static Box3T Empty () {
+			T const h = std::numeric_limits<T>::max ();
+			return Box3T (Vector3T<T> (h), Vector3T<T> (-h)); }
+
+		bool IsEmpty () const {return min.x > max.x || min.y > max.y || min.z > max.z;}
+
+		// Grows the box to contain a point or another box.
+		//
+		Box3T& Extend (Vector3T<T> const& p) {
+			min.x = p.x < min.x ? p.x : min.x; max.x = p.x > max.x ? p.x : max.x;
+			min.y = p.y < min.y ? p.y : min.y; max.y = p.y > max.y ? p.y : max.y;
+			min.z = p.z < min.z ? p.z : min.z; max.z = p.z > max.z ? p.z : max.z;
+			return *this; }
+		Box3T& Extend (Box3T const& b) {Extend (b.min); return Extend (b.max);}
+
+		// Geometry.
+		//
+		Vector3T<T> Center () const {return (min + max) * T(0.5);}
+		Vector3T<T> Extent () const {return max - min;}
+		T SurfaceArea () const {Vector3T<T> e = Extent (); return T(2) * (e.x*e.y + e.y*e.z + e.z*e.x);}
+
+		// Containment and overlap (boundaries included).
+		//
+		bool Contains (Vector3T<T> const& p) const {
+			return (p.x >= min.x) & (p.x <= max.x) & (p.y >= min.y) & (p.y <= max.y) & (p.z >= min.z) & (p.z <= max.z);}
+		bool Overlaps (Box3T const& b) const {
+			return (b.min.x <= max.x) & (b.max.x >= min.x) & (b.min.y <= max.y) & (b.max.y >= min.y) & (b.min.z <= max.z) & (b.max.z >= min.z);}
+
+		// Distance squared from a point to the box (0 inside).
+		//
+		T DistanceSq (Vector3T<T> const& p) const {
+			T dx = p.x < min.x ? min.x - p.x : (p.x > max.x ? p.x - max.x : T(0));
+			T dy = p.y < min.y ? min.y - p.y : (p.y > max.y ? p.y - max.y : T(0));
+			T dz = p.z < min.z ? min.z - p.z : (p.z > max.z ? p.z - max.z : T(0));
+			return dx*dx + dy*dy + dz*dz; }
+	};
+
+	// The FLOAT_TYPE box.
+	//
+	typedef Box3T<Scalar> Box3;
+}
+
+#endif // BOX3_H
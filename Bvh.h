@@ -0,0 +1,496 @@
+#ifndef VEC_BVH_H
+#define VEC_BVH_H
+
+#include <cstddef> // size_t
+#include <cstdint>
+#include <cassert>
+#include <cmath>
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <vector>
+
+#include "Vector3.h"
+#include "Box3.h"
+#include "Vector3Batch.h"
+
+// ************************************************************************************
+// RayT and HitT structures - A ray segment and the closest triangle it hits.
+//
+//
+// ************************************************************************************
+//
+namespace Vec
+{
+	template <class T>
+	struct RayT
+	{
+		Vector3T<T> origin, dir;
+		T tmin, tmax;
+
+		// Constructors. The ray covers origin + t*dir for tmin <= t <= tmax.
+		//
+		RayT () = default;
+		RayT (Vector3T<T> const& origin, Vector3T<T> const& dir, T tmin = T(0), T tmax = std::numeric_limits<T>::max ())
+			: origin(origin), dir(dir), tmin(tmin), tmax(tmax) {}
+	};
+
+	template <class T>
+	struct HitT
+	{
+		// Triangle index of a miss.
+		//
+		static const size_t None = size_t(-1);
+
+		T t, u, v;       // ray parameter and barycentrics of the hit
+		size_t triangle; // index into the triangles the BVH was built from
+
+		bool Valid () const {return triangle != None;}
+	};
+
+	// The FLOAT_TYPE ray and hit.
+	//
+	typedef RayT<Scalar> Ray;
+	typedef HitT<Scalar> Hit;
+}
+
+
+// ************************************************************************************
+// Vec::detail namespace - BVH nodes and the SIMD slab tests.
+//
+// A node holds the boxes of up to four children as structure of arrays, so
+// one SSE register tests all four against a ray (float only; double runs
+// the same code one lane at a time). count[i] is zero for an inner child,
+// whose node is child[i], and otherwise the triangle count of a leaf
+// starting at child[i]; bit i of mask marks the slots in use.
+//
+// ************************************************************************************
+//
+namespace Vec
+{
+	namespace detail
+	{
+		template <class T>
+		struct BvhNode
+		{
+			T lo[3][4], hi[3][4];
+			uint32_t child[4], count[4];
+			uint32_t mask;
+		};
+
+		// A ray prepared for slab tests.
+		//
+		template <class T>
+		struct BvhRay
+		{
+			T o[3], inv[3];
+			int neg[3];
+
+			BvhRay (RayT<T> const& r) {
+				T const d[3] = {r.dir.x, r.dir.y, r.dir.z};
+				o[0] = r.origin.x; o[1] = r.origin.y; o[2] = r.origin.z;
+				// signbit, not < 0: a -0 component has inv -inf and must take the
+				// negative slab order.
+				for (int a = 0; a < 3; ++a) {inv[a] = T(1) / d[a]; neg[a] = std::signbit (d[a]);} }
+		};
+
+		// Mask of the children of n the ray enters within [tmin, tmax], with
+		// the entry distances in tnear.
+		//
+		template <class T> inline
+		int bvh_slab (BvhNode<T> const& n, BvhRay<T> const& r, T tmin, T tmax, T* tnear) {
+			int m = 0;
+			for (int i = 0; i < 4; ++i) {
+				T t0 = tmin, t1 = tmax;
+				for (int a = 0; a < 3; ++a) {
+					T const* nb = r.neg[a] ? n.hi[a] : n.lo[a];
+					T const* fb = r.neg[a] ? n.lo[a] : n.hi[a];
+					T tn = (nb[i] - r.o[a]) * r.inv[a], tf = (fb[i] - r.o[a]) * r.inv[a];
+					t0 = tn > t0 ? tn : t0; t1 = tf < t1 ? tf : t1; }
+				tnear[i] = t0;
+				m |= int (t0 <= t1) << i; }
+			return m & int (n.mask); }
+
+#ifdef VECTOR3_HAS_SSE2
+		inline int bvh_slab (BvhNode<float> const& n, BvhRay<float> const& r, float tmin, float tmax, float* tnear) {
+			__m128 t0 = _mm_set1_ps (tmin), t1 = _mm_set1_ps (tmax);
+			for (int a = 0; a < 3; ++a) {
+				__m128 o = _mm_set1_ps (r.o[a]), inv = _mm_set1_ps (r.inv[a]);
+				__m128 nb = _mm_loadu_ps (r.neg[a] ? n.hi[a] : n.lo[a]), fb = _mm_loadu_ps (r.neg[a] ? n.lo[a] : n.hi[a]);
+				t0 = _mm_max_ps (_mm_mul_ps (_mm_sub_ps (nb, o), inv), t0);
+				t1 = _mm_min_ps (_mm_mul_ps (_mm_sub_ps (fb, o), inv), t1); }
+			_mm_storeu_ps (tnear, t0);
+			return _mm_movemask_ps (_mm_cmple_ps (t0, t1)) & int (n.mask); }
+#endif
+
+		// Up to four rays as structure of arrays, for packet traversal.
+		//
+		template <class T>
+		struct BvhPacket
+		{
+			T o[3][4], inv[3][4], tmin[4], tmax[4];
+			int lanes;
+		};
+
+		// Whether any ray of the packet enters box i of n.
+		//
+		template <class T> inline
+		bool bvh_slab_packet (BvhNode<T> const& n, int i, BvhPacket<T> const& p) {
+			for (int l = 0; l < p.lanes; ++l) {
+				T t0 = p.tmin[l], t1 = p.tmax[l];
+				for (int a = 0; a < 3; ++a) {
+					T ta = (n.lo[a][i] - p.o[a][l]) * p.inv[a][l], tb = (n.hi[a][i] - p.o[a][l]) * p.inv[a][l];
+					t0 = std::max (t0, std::min (ta, tb)); t1 = std::min (t1, std::max (ta, tb)); }
+				if (t0 <= t1) return true; }
+			return false; }
+
+#ifdef VECTOR3_HAS_SSE2
+		inline bool bvh_slab_packet (BvhNode<float> const& n, int i, BvhPacket<float> const& p) {
+			__m128 t0 = _mm_loadu_ps (p.tmin), t1 = _mm_loadu_ps (p.tmax);
+			for (int a = 0; a < 3; ++a) {
+				__m128 o = _mm_loadu_ps (p.o[a]), inv = _mm_loadu_ps (p.inv[a]);
+				__m128 ta = _mm_mul_ps (_mm_sub_ps (_mm_set1_ps (n.lo[a][i]), o), inv);
+				__m128 tb = _mm_mul_ps (_mm_sub_ps (_mm_set1_ps (n.hi[a][i]), o), inv);
+				t0 = _mm_max_ps (t0, _mm_min_ps (ta, tb)); t1 = _mm_min_ps (t1, _mm_max_ps (ta, tb)); }
+			return (_mm_movemask_ps (_mm_cmple_ps (t0, t1)) & ((1 << p.lanes) - 1)) != 0; }
+#endif
+	}
+}
+
+
+// ************************************************************************************
+// BvhT class - Four-wide bounding volume hierarchy over triangles.
+//
+// Built from n triangles given as 3n Vector3T vertices (a, b, c per
+// triangle) with a binned surface area heuristic; the binary tree is then
+// collapsed so each node tests four child boxes at once. Rays hit both
+// faces of a triangle (Moller-Trumbore). Intersect traces one ray or a
+// stream of independent rays; IntersectPacket traces up to four rays
+// together, which pays off only for coherent rays such as primary camera
+// rays. The BVH is immutable after Build and may be queried concurrently.
+//
+// ************************************************************************************
+//
+namespace Vec
+{
+	template <class T>
+	class BvhT
+	{
+	public:
+		// Most triangles in a leaf, and the number of SAH bins.
+		//
+		static const size_t MaxLeaf = 4;
+		static const int Bins = 16;
+
+		// Constructors.
+		//
+		BvhT () {}
+		BvhT (Vector3T<T> const* v, size_t n, batch::Policy const& p = batch::Policy ()) {Build (v, n, p);}
+
+		// Builds the hierarchy. With a parallel policy the top levels are split
+		// serially and the resulting subtrees are built concurrently.
+		//
+		void Build (Vector3T<T> const* v, size_t n, batch::Policy const& p = batch::Policy ()) {
+			assert (n < size_t (UINT32_MAX));
+			nodes.clear (); tris.clear (); ids.clear ();
+			box = Box3T<T>::Empty ();
+			if (n == 0) return;
+			Builder b (v, n);
+			b.Run (p);
+			box = b.nodes[0].box;
+			tris.resize (n); ids.resize (n);
+			for (size_t i = 0; i < n; ++i) {
+				size_t t = b.prim[i];
+				Vector3T<T> const& a = v[3*t];
+				tris[i].v0 = a; tris[i].e1 = v[3*t + 1] - a; tris[i].e2 = v[3*t + 2] - a;
+				ids[i] = uint32_t (t); }
+			nodes.reserve (b.used / 2 + 1);
+			if (b.nodes[0].count) {
+				nodes.resize (1);
+				Slot (nodes[0], 0, b.nodes[0]);
+				nodes[0].mask = 1; }
+			else Collapse (b, 0); }
+
+		size_t Size () const {return tris.size ();}
+		Box3T<T> const& Bounds () const {return box;}
+
+		// Closest hit along a ray; h is left alone on a miss.
+		//
+		bool Intersect (RayT<T> const& r, HitT<T>& h) const {
+			if (nodes.empty ()) return false;
+			detail::BvhRay<T> const pre (r);
+			T tmax = r.tmax;
+			bool hit = false;
+			uint32_t stack[Depth]; T near[Depth];
+			size_t sp = 0;
+			stack[sp] = 0; near[sp++] = r.tmin;
+			while (sp) {
+				--sp;
+				if (near[sp] > tmax) continue;
+				detail::BvhNode<T> const& n = nodes[stack[sp]];
+				T tn[4];
+				int m = detail::bvh_slab (n, pre, r.tmin, tmax, tn);
+				// Leaves now, inner children pushed farthest first.
+				int order[4], k = 0;
+				for (int i = 0; i < 4; ++i) {
+					if (!(m >> i & 1)) continue;
+					if (n.count[i]) {
+						for (uint32_t j = n.child[i], e = j + n.count[i]; j < e; ++j)
+							if (Triangle (r, j, tmax, h)) hit = true; }
+					else {
+						int s = k++;
+						for (; s > 0 && tn[order[s - 1]] < tn[i]; --s) order[s] = order[s - 1];
+						order[s] = i; } }
+				for (int s = 0; s < k; ++s) {
+					assert (sp < Depth);
+					stack[sp] = n.child[order[s]]; near[sp++] = tn[order[s]]; } }
+			return hit; }
+
+		// Whether anything blocks the ray; stops at the first hit.
+		//
+		bool Occluded (RayT<T> const& r) const {
+			if (nodes.empty ()) return false;
+			detail::BvhRay<T> const pre (r);
+			T tmax = r.tmax;
+			HitT<T> h;
+			uint32_t stack[Depth];
+			size_t sp = 0;
+			stack[sp++] = 0;
+			while (sp) {
+				detail::BvhNode<T> const& n = nodes[stack[--sp]];
+				T tn[4];
+				int m = detail::bvh_slab (n, pre, r.tmin, tmax, tn);
+				for (int i = 0; i < 4; ++i) {
+					if (!(m >> i & 1)) continue;
+					if (n.count[i]) {
+						for (uint32_t j = n.child[i], e = j + n.count[i]; j < e; ++j)
+							if (Triangle (r, j, tmax, h)) return true; }
+					else {assert (sp < Depth); stack[sp++] = n.child[i];} } }
+			return false; }
+
+		// A stream of independent rays: hits[i] gets the closest hit of
+		// rays[i], with HitT::None as the triangle of a miss.
+		//
+		void Intersect (RayT<T> const* rays, HitT<T>* hits, size_t n, batch::Policy const& p = batch::Policy ()) const {
+			batch::For (n, p, [this, rays, hits] (size_t b, size_t e) {
+				for (size_t i = b; i < e; ++i) {
+					hits[i].triangle = HitT<T>::None;
+					Intersect (rays[i], hits[i]); } }); }
+
+		// Up to four rays traced together: a node is opened when any of them
+		// enters it. Results as the stream Intersect.
+		//
+		void IntersectPacket (RayT<T> const* rays, HitT<T>* hits, size_t n) const {
+			assert (n <= 4);
+			for (size_t l = 0; l < n; ++l) hits[l].triangle = HitT<T>::None;
+			if (nodes.empty () || n == 0) return;
+			detail::BvhPacket<T> pk;
+			pk.lanes = int (n);
+			for (int l = 0; l < 4; ++l) {
+				RayT<T> const& r = rays[size_t (l) < n ? l : 0];
+				T const o[3] = {r.origin.x, r.origin.y, r.origin.z}, d[3] = {r.dir.x, r.dir.y, r.dir.z};
+				for (int a = 0; a < 3; ++a) {pk.o[a][l] = o[a]; pk.inv[a][l] = T(1) / d[a];}
+				pk.tmin[l] = r.tmin; pk.tmax[l] = r.tmax; }
+			uint32_t stack[Depth];
+			size_t sp = 0;
+			stack[sp++] = 0;
+			while (sp) {
+				detail::BvhNode<T> const& nd = nodes[stack[--sp]];
+				for (int i = 0; i < 4; ++i) {
+					if (!(nd.mask >> i & 1) || !detail::bvh_slab_packet (nd, i, pk)) continue;
+					if (nd.count[i]) {
+						for (size_t l = 0; l < n; ++l)
+							for (uint32_t j = nd.child[i], e = j + nd.count[i]; j < e; ++j)
+								Triangle (rays[l], j, pk.tmax[l], hits[l]); }
+					else {assert (sp < Depth); stack[sp++] = nd.child[i];} } } }
+
+		// A stream of coherent rays traced as packets of four.
+		//
+		void IntersectPackets (RayT<T> const* rays, HitT<T>* hits, size_t n, batch::Policy const& p = batch::Policy ()) const {
+			batch::For ((n + 3) / 4, p, [this, rays, hits, n] (size_t b, size_t e) {
+				for (size_t i = b; i < e; ++i) IntersectPacket (rays + 4*i, hits + 4*i, std::min (n - 4*i, size_t(4))); }); }
+
+	private:
+		// Deepest SAH split; below it nodes split at the object median, so a
+		// binary tree is at most MaxBuildDepth + 32 levels deep (n < 2^32).
+		// Traversal pushes at most three nodes per level of the collapsed
+		// tree, which is no deeper, so Depth entries always suffice.
+		//
+		static const uint32_t MaxBuildDepth = 48;
+		static const size_t Depth = 256;
+		static_assert (3 * (MaxBuildDepth + 32) + 1 <= Depth, "Traversal stack too small");
+
+		struct Tri {Vector3T<T> v0, e1, e2;};
+
+		// Binary build tree: count is zero for inner nodes.
+		//
+		struct BuildNode
+		{
+			Box3T<T> box;
+			uint32_t left, right, first, count, depth;
+		};
+
+		struct Builder
+		{
+			std::vector<Box3T<T> > boxes;
+			std::vector<Vector3T<T> > centers;
+			std::vector<uint32_t> prim;
+			std::vector<BuildNode> nodes;
+			std::atomic<size_t> used;
+
+			Builder (Vector3T<T> const* v, size_t n) : boxes (n), centers (n), prim (n), nodes (2*n), used (1) {
+				for (size_t i = 0; i < n; ++i) {
+					boxes[i] = Box3T<T>::Empty ();
+					boxes[i].Extend (v[3*i]).Extend (v[3*i + 1]).Extend (v[3*i + 2]);
+					centers[i] = boxes[i].Center ();
+					prim[i] = uint32_t (i); }
+				nodes[0].first = 0; nodes[0].count = uint32_t (n); nodes[0].depth = 0; }
+
+			// Builds the top levels serially, then the subtrees under p.
+			//
+			void Run (batch::Policy const& p) {
+				size_t const want = (p.pool ? p.pool->Size () : 1) * 4;
+				std::vector<uint32_t> tasks (1, 0), next;
+				while (tasks.size () < want) {
+					bool more = false;
+					next.clear ();
+					for (size_t t = 0; t < tasks.size (); ++t) {
+						uint32_t i = tasks[t];
+						if (Split (i)) {next.push_back (nodes[i].left); next.push_back (nodes[i].right); more = true;}
+						else next.push_back (i); }
+					tasks.swap (next);
+					if (!more) break; }
+				batch::Policy each (p); each.chunk = 1;
+				batch::For (tasks.size (), each, [&] (size_t b, size_t e) {
+					for (size_t t = b; t < e; ++t) Recurse (tasks[t]); }); }
+
+			void Recurse (uint32_t i) {
+				if (nodes[i].count == 0) {Recurse (nodes[i].left); Recurse (nodes[i].right); return;}
+				if (!Split (i)) return;
+				Recurse (nodes[i].left);
+				Recurse (nodes[i].right); }
+
+			// Sets the bounds of leaf i and splits it in two when the SAH
+			// says so or it is too large. Returns whether it split.
+			//
+			bool Split (uint32_t i) {
+				BuildNode& nd = nodes[i];
+				size_t const b = nd.first, e = b + nd.count, n = nd.count;
+				Box3T<T> cb = Box3T<T>::Empty ();
+				nd.box = Box3T<T>::Empty ();
+				for (size_t j = b; j < e; ++j) {nd.box.Extend (boxes[prim[j]]); cb.Extend (centers[prim[j]]);}
+				if (n <= 1) return false;
+				Vector3T<T> ext = cb.Extent ();
+				int const a = (ext.x >= ext.y && ext.x >= ext.z) ? 0 : (ext.y >= ext.z ? 1 : 2);
+				T const lo = detail::axis (cb.min, a), w = detail::axis (ext, a);
+				size_t mid = b;
+				if (nd.depth >= MaxBuildDepth) {
+					if (n <= MaxLeaf) return false; }
+				else if (w > T(0)) {
+					size_t cnt[Bins] = {};
+					Box3T<T> bb[Bins];
+					for (int k = 0; k < Bins; ++k) bb[k] = Box3T<T>::Empty ();
+					T const s = T(Bins) / w;
+					for (size_t j = b; j < e; ++j) {
+						int k = Bin (centers[prim[j]], a, lo, s);
+						++cnt[k]; bb[k].Extend (boxes[prim[j]]); }
+					// Cost of splitting after bin k: Nl*Al + Nr*Ar.
+					T right[Bins];
+					Box3T<T> acc = Box3T<T>::Empty ();
+					size_t nr = 0;
+					for (int k = Bins - 1; k > 0; --k) {
+						acc.Extend (bb[k]); nr += cnt[k];
+						right[k - 1] = nr ? T(nr) * acc.SurfaceArea () : T(0); }
+					acc = Box3T<T>::Empty ();
+					size_t nl = 0;
+					T best = std::numeric_limits<T>::max ();
+					int split = -1;
+					for (int k = 0; k < Bins - 1; ++k) {
+						acc.Extend (bb[k]); nl += cnt[k];
+						if (nl == 0 || nl == n) continue;
+						T c = T(nl) * acc.SurfaceArea () + right[k];
+						if (c < best) {best = c; split = k;} }
+					if (split >= 0 && n <= MaxLeaf && best >= T(n) * nd.box.SurfaceArea ()) return false;
+					if (split >= 0)
+						mid = std::partition (prim.begin () + b, prim.begin () + e, [&] (uint32_t t) {
+							return Bin (centers[t], a, lo, s) <= split; }) - prim.begin (); }
+				else if (n <= MaxLeaf) return false;
+				if (mid == b || mid == e) {
+					// Coincident centers or past MaxBuildDepth: split at the median.
+					mid = b + n / 2;
+					std::nth_element (prim.begin () + b, prim.begin () + mid, prim.begin () + e, [&] (uint32_t l, uint32_t r) {
+						return detail::axis (centers[l], a) < detail::axis (centers[r], a); }); }
+				uint32_t l = uint32_t (used.fetch_add (2));
+				nodes[l].first = uint32_t (b); nodes[l].count = uint32_t (mid - b); nodes[l].depth = nd.depth + 1;
+				nodes[l + 1].first = uint32_t (mid); nodes[l + 1].count = uint32_t (e - mid); nodes[l + 1].depth = nd.depth + 1;
+				nd.left = l; nd.right = l + 1; nd.count = 0;
+				return true; }
+
+			static int Bin (Vector3T<T> const& c, int a, T lo, T s) {
+				int k = int ((detail::axis (c, a) - lo) * s);
+				return k < 0 ? 0 : (k >= Bins ? Bins - 1 : k); }
+		};
+
+		// Fills slot i of a node from a build node.
+		//
+		static void Slot (detail::BvhNode<T>& n, int i, BuildNode const& b) {
+			for (int a = 0; a < 3; ++a) {n.lo[a][i] = detail::axis (b.box.min, a); n.hi[a][i] = detail::axis (b.box.max, a);}
+			n.child[i] = b.first; n.count[i] = b.count; }
+
+		// Emits the four-wide node of inner build node i, opening the largest
+		// inner grandchildren until it has four children. Returns its index.
+		//
+		uint32_t Collapse (Builder const& b, uint32_t i) {
+			uint32_t kids[4] = {b.nodes[i].left, b.nodes[i].right};
+			int k = 2;
+			while (k < 4) {
+				int open = -1; T area = T(-1);
+				for (int j = 0; j < k; ++j) {
+					BuildNode const& c = b.nodes[kids[j]];
+					if (c.count == 0 && c.box.SurfaceArea () > area) {area = c.box.SurfaceArea (); open = j;} }
+				if (open < 0) break;
+				uint32_t o = kids[open];
+				kids[open] = b.nodes[o].left; kids[k++] = b.nodes[o].right; }
+			uint32_t const self = uint32_t (nodes.size ());
+			nodes.push_back (detail::BvhNode<T> ());
+			nodes[self].mask = (1u << k) - 1;
+			for (int j = 0; j < 4; ++j) {
+				BuildNode const& c = b.nodes[kids[j < k ? j : 0]];
+				Slot (nodes[self], j, c);
+				if (j < k && c.count == 0) {
+					uint32_t child = Collapse (b, kids[j]);
+					nodes[self].child[j] = child; } }
+			return self; }
+
+		// Moller-Trumbore test of triangle j; on a hit nearer than tmax it
+		// fills h and shrinks tmax.
+		//
+		bool Triangle (RayT<T> const& r, uint32_t j, T& tmax, HitT<T>& h) const {
+			Tri const& t = tris[j];
+			Vector3T<T> pv = Vec::Cross (r.dir, t.e2);
+			T det = Vec::Dot (t.e1, pv);
+			if (det == T(0)) return false;
+			T inv = T(1) / det;
+			Vector3T<T> tv = r.origin - t.v0;
+			T u = Vec::Dot (tv, pv) * inv;
+			if (u < T(0) || u > T(1)) return false;
+			Vector3T<T> qv = Vec::Cross (tv, t.e1);
+			T v = Vec::Dot (r.dir, qv) * inv;
+			if (v < T(0) || u + v > T(1)) return false;
+			T d = Vec::Dot (t.e2, qv) * inv;
+			if (d < r.tmin || d > tmax) return false;
+			tmax = d; h.t = d; h.u = u; h.v = v; h.triangle = ids[j];
+			return true; }
+
+		std::vector<detail::BvhNode<T> > nodes; // root first
+		std::vector<Tri> tris;                   // leaf order
+		std::vector<uint32_t> ids;               // original index of each triangle
+		Box3T<T> box;
+	};
+
+	// The FLOAT_TYPE BVH.
+	//
+	typedef BvhT<Scalar> Bvh;
+}
+
+#endif // VEC_BVH_H
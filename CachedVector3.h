@@ -0,0 +1,83 @@
+#ifndef CACHED_VECTOR3_H
+#define CACHED_VECTOR3_H
+
+#include "Vector3.h"
+
+// ************************************************************************************
+// CachedVector3T class - Vector3T that memoizes its length and direction.
+//
+// For vectors that change rarely but are measured often. Length and Unit
+// compute sqrt once and reuse it until the next mutation; every mutating
+// member invalidates the cache, so the components are only writable through
+// them. The results are those of Vector3T::Length and Vec::Unit. Const
+// members fill the cache, so a CachedVector3T shared between threads needs
+// the same locking as a non-const object. Plain Vector3T is unaffected.
+//
+// ************************************************************************************
+//
+namespace Vec
+{
+	template <class T>
+	class CachedVector3T
+	{
+	public:
+		typedef T Scalar;
+
+		CachedVector3T () : v(T(0)), unit(T(0)), length(T(0)), cached(false) {}
+		CachedVector3T (Vector3T<T> const& v) : v(v), unit(T(0)), length(T(0)), cached(false) {}
+		CachedVector3T (T x, T y, T z) : v(x, y, z), unit(T(0)), length(T(0)), cached(false) {}
+
+		// The vector.
+		//
+		Vector3T<T> const& Get () const {return v;}
+		operator Vector3T<T> const& () const {return v;}
+		CachedVector3T& operator= (Vector3T<T> const& w) {v = w; cached = false; return *this;}
+
+		// Mutating operators.
+		//
+		CachedVector3T& operator*= (T s) {v *= s; cached = false; return *this;}
+		CachedVector3T& operator/= (T s) {v /= s; cached = false; return *this;}
+		CachedVector3T& operator+= (Vector3T<T> const& w) {v += w; cached = false; return *this;}
+		CachedVector3T& operator-= (Vector3T<T> const& w) {v -= w; cached = false; return *this;}
+		void Zero () {v.Zero (); cached = false;}
+
+		// Converts this vector into its unit vector (returns the previous length).
+		//
+		T Normalize () {
+			Fill ();
+			T m = length;
+			v = unit; cached = false;
+			return m; }
+
+		// Cached length and unit vector.
+		//
+		T LengthSq () const {return v.LengthSq ();}
+		T Length () const {Fill (); return length;}
+		Vector3T<T> const& Unit () const {Fill (); return unit;}
+
+		// True when Length and Unit are computed.
+		//
+		bool Cached () const {return cached;}
+
+	private:
+		// The same operations as Vector3T::Normalize.
+		//
+		void Fill () const {
+			if (cached) return;
+			length = std::sqrt (v.x*v.x + v.y*v.y + v.z*v.z);
+			T mi = T(1)/length;
+			unit = Vector3T<T> (v.x*mi, v.y*mi, v.z*mi);
+			cached = true; }
+
+		Vector3T<T> v;
+		mutable Vector3T<T> unit;
+		mutable T length;
+		mutable bool cached;
+	};
+
+	// The FLOAT_TYPE cached vector.
+	//
+	typedef CachedVector3T<Scalar> CachedVector3;
+}
+
+#endif // CACHED_VECTOR3_H
@@ -0,0 +1,239 @@
+#ifndef VEC_INTERSECT_H
+#define VEC_INTERSECT_H
+
+#include <cstddef> // size_t
+#include <cstdint>
+#include <cassert>
+#include <cmath>
+#include <limits>
+
+#include "Vector3.h"
+#include "Vector3SoA.h"
+#include "Bvh.h"
+
+// ************************************************************************************
+// PlaneT and TrianglesSoAT structures - Inputs of the batched predicates.
+//
+// A plane holds the points p with Dot (normal, p) == d; the signed distance
+// of a point is Dot (normal, p) - d, in units of |normal|. Triangles are kept
+// as three SoA streams, the first vertex and the two edges leaving it, so the
+// ray test reads them without precomputation.
+//
+// ************************************************************************************
+//
+namespace Vec
+{
+	template <class T>
+	struct PlaneT
+	{
+		Vector3T<T> normal;
+		T d;
+
+		// Constructors.
+		//
+		PlaneT () = default;
+		PlaneT (Vector3T<T> const& normal, T d) : normal(normal), d(d) {}
+
+		// The plane through p with the given normal.
+		//
+		static PlaneT FromPoint (Vector3T<T> const& normal, Vector3T<T> const& p) {return PlaneT (normal, Vec::Dot (normal, p));}
+
+		// Signed distance of p.
+		//
+		T Distance (Vector3T<T> const& p) const {return Vec::Dot (normal, p) - d;}
+	};
+
+	template <class T>
+	struct TrianglesSoAT
+	{
+		typedef T Scalar;
+
+		Vector3SoAT<T> v0, e1, e2; // first vertex, v1 - v0 and v2 - v0
+
+		// Constructors. Triangle i has the vertices v[3i], v[3i+1] and v[3i+2],
+		// the same layout BvhT is built from.
+		//
+		TrianglesSoAT () {}
+		TrianglesSoAT (Vector3T<T> const* v, size_t n) {Assign (v, n);}
+
+		// Replaces the triangles with the n triangles of v.
+		//
+		void Assign (Vector3T<T> const* v, size_t n) {
+			v0.Resize (n); e1.Resize (n); e2.Resize (n);
+			for (size_t i = 0; i < n; ++i) {
+				Vector3T<T> const* t = v + 3*i;
+				v0.Set (i, t[0]); e1.Set (i, t[1] - t[0]); e2.Set (i, t[2] - t[0]); } }
+
+		// Number of triangles.
+		//
+		size_t Size () const {return v0.Size ();}
+	};
+
+	// The FLOAT_TYPE plane and triangles.
+	//
+	typedef PlaneT<Scalar> Plane;
+	typedef TrianglesSoAT<Scalar> TrianglesSoA;
+}
+
+
+// ************************************************************************************
+// Vec namespace - Batched geometric predicates.
+//
+// One ray against many triangles, many points against one plane or one
+// segment. Inputs are SoA; every function writes per-element distances and a
+// mask of 0 and 1 bytes, and returns the number of set mask bytes. Mask and
+// distance arrays hold Size() elements and may not alias the inputs.
+//
+// The ray test runs in blocks of 16 triangles: the determinant and first
+// barycentric are computed for the whole block, and a block where they reject
+// every triangle skips the rest of the test. Both stages are branch-free
+// loops written for the auto-vectorizer, which GCC runs at -O3 or with
+// -ftree-vectorize; an -O2 build runs them as scalar loops. The tests are
+// those of BvhT's Moller-Trumbore test.
+//
+// ************************************************************************************
+//
+namespace Vec
+{
+	namespace detail
+	{
+		static const size_t IntersectLanes = 16;
+
+		// Stage one of the ray test for triangles [s, s+m): stores 1/det and u
+		// and returns whether any lane survives.
+		//
+		template <class T> inline
+		bool ray_triangles_uv (RayT<T> const& r, TrianglesSoAT<T> const& tri, size_t s, size_t m, T* VEC_RESTRICT inv, T* VEC_RESTRICT u, uint8_t* VEC_RESTRICT ok) {
+			VEC_SOA_STREAMS (v, tri.v0, const); VEC_SOA_STREAMS (a, tri.e1, const); VEC_SOA_STREAMS (b, tri.e2, const);
+			T const dx = r.dir.x, dy = r.dir.y, dz = r.dir.z;
+			T const ox = r.origin.x, oy = r.origin.y, oz = r.origin.z;
+			unsigned any = 0;
+			for (size_t l = 0; l < m; ++l) {
+				size_t const i = s + l;
+				T px = dy*bz[i] - dz*by[i], py = dz*bx[i] - dx*bz[i], pz = dx*by[i] - dy*bx[i];
+				T det = ax[i]*px + ay[i]*py + az[i]*pz;
+				T di = T(1)/det;
+				T tx = ox - vx[i], ty = oy - vy[i], tz = oz - vz[i];
+				T uu = (tx*px + ty*py + tz*pz) * di;
+				unsigned k = (det != T(0)) & (uu >= T(0)) & (uu <= T(1));
+				inv[l] = di; u[l] = uu; ok[l] = uint8_t (k); any |= k; }
+			return any != 0; }
+
+		// Stage two: v and t of the surviving lanes, written to t[l] and hit[l].
+		//
+		template <class T> inline
+		size_t ray_triangles_t (RayT<T> const& r, TrianglesSoAT<T> const& tri, size_t s, size_t m, T const* VEC_RESTRICT inv, T const* VEC_RESTRICT u, uint8_t const* VEC_RESTRICT ok, T* VEC_RESTRICT t, uint8_t* VEC_RESTRICT hit) {
+			VEC_SOA_STREAMS (v, tri.v0, const); VEC_SOA_STREAMS (a, tri.e1, const); VEC_SOA_STREAMS (b, tri.e2, const);
+			T const dx = r.dir.x, dy = r.dir.y, dz = r.dir.z;
+			T const ox = r.origin.x, oy = r.origin.y, oz = r.origin.z;
+			T const miss = std::numeric_limits<T>::infinity ();
+			size_t count = 0;
+			for (size_t l = 0; l < m; ++l) {
+				size_t const i = s + l;
+				T tx = ox - vx[i], ty = oy - vy[i], tz = oz - vz[i];
+				T qx = ty*az[i] - tz*ay[i], qy = tz*ax[i] - tx*az[i], qz = tx*ay[i] - ty*ax[i];
+				T vv = (dx*qx + dy*qy + dz*qz) * inv[l];
+				T d = (bx[i]*qx + by[i]*qy + bz[i]*qz) * inv[l];
+				unsigned h = ok[l] & (vv >= T(0)) & (u[l] + vv <= T(1)) & (d >= r.tmin) & (d <= r.tmax);
+				t[l] = h ? d : miss; hit[l] = uint8_t (h); count += h; }
+			return count; }
+	}
+
+	// Tests r against every triangle. t receives the ray parameter of each
+	// hit and infinity for a miss; hit may be null.
+	//
+	template <class T> inline
+	size_t Intersect (RayT<T> const& r, TrianglesSoAT<T> const& tri, T* VEC_RESTRICT t, uint8_t* VEC_RESTRICT hit) {
+		size_t const L = detail::IntersectLanes, n = tri.Size ();
+		T inv[L], u[L]; uint8_t ok[L], h[L];
+		size_t count = 0;
+		for (size_t s = 0; s < n; s += L) {
+			size_t const m = n - s < L ? n - s : L;
+			uint8_t* hb = hit ? hit + s : h;
+			if (detail::ray_triangles_uv (r, tri, s, m, inv, u, ok))
+				count += detail::ray_triangles_t (r, tri, s, m, inv, u, ok, t + s, hb);
+			else
+				for (size_t l = 0; l < m; ++l) {t[s + l] = std::numeric_limits<T>::infinity (); hb[l] = 0;} }
+		return count; }
+
+	// The nearest triangle r hits, or HitT::None. Only t, u, v and triangle
+	// of the result are meaningful; u and v are the barycentrics.
+	//
+	template <class T> inline
+	HitT<T> Closest (RayT<T> const& r, TrianglesSoAT<T> const& tri) {
+		size_t const L = detail::IntersectLanes, n = tri.Size ();
+		T inv[L], u[L], t[L]; uint8_t ok[L], hit[L];
+		HitT<T> best; best.t = r.tmax; best.u = best.v = T(0); best.triangle = HitT<T>::None;
+		RayT<T> q = r;
+		for (size_t s = 0; s < n; s += L) {
+			size_t const m = n - s < L ? n - s : L;
+			if (!detail::ray_triangles_uv (q, tri, s, m, inv, u, ok)) continue;
+			if (!detail::ray_triangles_t (q, tri, s, m, inv, u, ok, t, hit)) continue;
+			for (size_t l = 0; l < m; ++l)
+				if (hit[l] && t[l] <= q.tmax) {q.tmax = t[l]; best.triangle = s + l;} }
+		if (best.Valid ()) {
+			// Barycentrics of the winner, as BvhT computes them.
+			size_t const i = best.triangle;
+			Vector3T<T> e1 = tri.e1.Get (i), e2 = tri.e2.Get (i);
+			Vector3T<T> pv = Vec::Cross (r.dir, e2), tv = r.origin - tri.v0.Get (i), qv = Vec::Cross (tv, e1);
+			T di = T(1) / Vec::Dot (e1, pv);
+			best.t = q.tmax; best.u = Vec::Dot (tv, pv) * di; best.v = Vec::Dot (r.dir, qv) * di; }
+		return best; }
+
+	// True when r hits any triangle; stops at the first block with a hit.
+	//
+	template <class T> inline
+	bool Occluded (RayT<T> const& r, TrianglesSoAT<T> const& tri) {
+		size_t const L = detail::IntersectLanes, n = tri.Size ();
+		T inv[L], u[L], t[L]; uint8_t ok[L], hit[L];
+		for (size_t s = 0; s < n; s += L) {
+			size_t const m = n - s < L ? n - s : L;
+			if (detail::ray_triangles_uv (r, tri, s, m, inv, u, ok) && detail::ray_triangles_t (r, tri, s, m, inv, u, ok, t, hit))
+				return true; }
+		return false; }
+
+	// Signed distance of every point to pl; front, which may be null, marks
+	// the points with a positive distance.
+	//
+	template <class T> inline
+	size_t SignedDistance (PlaneT<T> const& pl, Vector3SoAT<T> const& p, T* VEC_RESTRICT out, uint8_t* VEC_RESTRICT front = 0) {
+		VEC_SOA_STREAMS (a, p, const); size_t const n = p.Size ();
+		T const nx = pl.normal.x, ny = pl.normal.y, nz = pl.normal.z, d = pl.d;
+		for (size_t i = 0; i < n; ++i) out[i] = ax[i]*nx + ay[i]*ny + az[i]*nz - d;
+		size_t count = 0;
+		if (front)
+			for (size_t i = 0; i < n; ++i) {unsigned f = out[i] > T(0); front[i] = uint8_t (f); count += f;}
+		return count; }
+
+	// Distance squared of every point to the segment [a, b]; within, which
+	// may be null, marks the points no farther than radius from it.
+	//
+	template <class T> inline
+	size_t SegmentDistanceSq (Vector3SoAT<T> const& p, Vector3T<T> const& a, Vector3T<T> const& b, T* VEC_RESTRICT out, uint8_t* VEC_RESTRICT within = 0, T radius = T(0)) {
+		VEC_SOA_STREAMS (q, p, const); size_t const n = p.Size ();
+		T const sx = a.x, sy = a.y, sz = a.z, ex = b.x - sx, ey = b.y - sy, ez = b.z - sz;
+		T const e2 = ex*ex + ey*ey + ez*ez;
+		T const ei = e2 > T(0) ? T(1)/e2 : T(0); // a point segment projects onto a
+		size_t const L = detail::IntersectLanes;
+		T c[L];
+		for (size_t s = 0; s < n; s += L) {
+			// The clamps are separate loops: a select feeding arithmetic keeps
+			// the compiler from vectorizing.
+			size_t const m = n - s < L ? n - s : L;
+			for (size_t l = 0; l < m; ++l) {
+				size_t const i = s + l;
+				T t = ((qx[i] - sx)*ex + (qy[i] - sy)*ey + (qz[i] - sz)*ez) * ei;
+				c[l] = t > T(0) ? t : T(0); }
+			for (size_t l = 0; l < m; ++l) c[l] = c[l] < T(1) ? c[l] : T(1);
+			for (size_t l = 0; l < m; ++l) {
+				size_t const i = s + l;
+				T dx = qx[i] - sx - c[l]*ex, dy = qy[i] - sy - c[l]*ey, dz = qz[i] - sz - c[l]*ez;
+				out[i] = dx*dx + dy*dy + dz*dz; } }
+		size_t count = 0;
+		if (within) {
+			T const r2 = radius*radius;
+			for (size_t i = 0; i < n; ++i) {unsigned w = out[i] <= r2; within[i] = uint8_t (w); count += w;} }
+		return count; }
+}
+
+#endif // VEC_INTERSECT_H
@@ -0,0 +1,210 @@
+#ifndef VEC_KDTREE_H
+#define VEC_KDTREE_H
+
+#include <cstddef> // size_t
+#include <cstdint>
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include "Vector3.h"
+#include "Box3.h"
+#include "Vector3Batch.h"
+
+// ************************************************************************************
+// Vec namespace - Helpers shared by the spatial indices.
+//
+//
+// ************************************************************************************
+//
+namespace Vec
+{
+	namespace detail
+	{
+		// Keeps the k best (index, distance squared) pairs sorted by distance.
+		//
+		template <class T>
+		struct Nearest
+		{
+			size_t* idx; T* dist; size_t k, count;
+
+			Nearest (size_t* idx, T* dist, size_t k) : idx(idx), dist(dist), k(k), count(0) {}
+
+			T Worst () const {return count < k ? std::numeric_limits<T>::max () : dist[count - 1];}
+
+			void Insert (size_t i, T d) {
+				if (d >= Worst ()) return;
+				size_t j = count < k ? count++ : k - 1;
+				for (; j > 0 && dist[j - 1] > d; --j) {dist[j] = dist[j - 1]; idx[j] = idx[j - 1];}
+				dist[j] = d; idx[j] = i; }
+		};
+	}
+}
+
+
+// ************************************************************************************
+// KdTreeT class - Static k-d tree over Vector3T points.
+//
+// The points are copied into tree order: the node of the index range
+// [lo, hi) is its median element mid, its children are [lo, mid) and
+// [mid+1, hi), and ranges of at most LeafSize points are scanned linearly.
+// There are no node pointers at all, and every subtree is one contiguous
+// run of points, so the lower levels of a search stay within a few cache
+// lines. The split axis of each range is its widest extent. Queries return
+// indices into the array the tree was built from.
+//
+// ************************************************************************************
+//
+namespace Vec
+{
+	template <class T>
+	class KdTreeT
+	{
+	public:
+		// Ranges of this many points or fewer are leaves.
+		//
+		static const size_t LeafSize = 8;
+
+		// Constructors.
+		//
+		KdTreeT () {}
+		KdTreeT (Vector3T<T> const* v, size_t n, batch::Policy const& p = batch::Policy ()) {Build (v, n, p);}
+
+		// Builds the tree. With a parallel policy the top levels are split
+		// serially and the resulting subtrees are built concurrently.
+		//
+		void Build (Vector3T<T> const* v, size_t n, batch::Policy const& p = batch::Policy ()) {
+			std::vector<Item> items (n);
+			for (size_t i = 0; i < n; ++i) {items[i].p = v[i]; items[i].i = i;}
+			split.assign (n, 0);
+			size_t const want = (p.pool ? p.pool->Size () : 1) * 4;
+			std::vector<Range> tasks (1, Range (0, n)), next;
+			while (tasks.size () < want) {
+				bool more = false;
+				next.clear ();
+				for (size_t t = 0; t < tasks.size (); ++t) {
+					Range r = tasks[t];
+					if (r.hi - r.lo <= LeafSize) {next.push_back (r); continue;}
+					size_t mid = Partition (items.data (), r.lo, r.hi);
+					next.push_back (Range (r.lo, mid)); next.push_back (Range (mid + 1, r.hi));
+					more = true; }
+				tasks.swap (next);
+				if (!more) break; }
+			batch::Policy each (p); each.chunk = 1;
+			batch::For (tasks.size (), each, [&] (size_t b, size_t e) {
+				for (size_t t = b; t < e; ++t) BuildRange (items.data (), tasks[t].lo, tasks[t].hi); });
+			points.resize (n); index.resize (n);
+			for (size_t i = 0; i < n; ++i) {points[i] = items[i].p; index[i] = items[i].i;} }
+
+		size_t Size () const {return points.size ();}
+
+		// The k nearest points to q, closest first: their indices go to idx and
+		// their squared distances to dist (both k long). Returns how many were
+		// found (less than k only when the tree is smaller).
+		//
+		size_t KNearest (Vector3T<T> const& q, size_t k, size_t* idx, T* dist) const {
+			if (k == 0) return 0;
+			detail::Nearest<T> best (idx, dist, k);
+			SearchK (q, 0, points.size (), best);
+			return best.count; }
+
+		// The index of the nearest point (the tree must not be empty).
+		//
+		size_t Nearest (Vector3T<T> const& q, T* dist = 0) const {
+			size_t i = 0; T d = T(0);
+			KNearest (q, 1, &i, &d);
+			if (dist) *dist = d;
+			return i; }
+
+		// Appends the indices of all points within distance r of q.
+		//
+		void Radius (Vector3T<T> const& q, T r, std::vector<size_t>& out) const {
+			SearchRadius (q, r*r, 0, points.size (), out); }
+
+		// Appends the indices of all points inside a box.
+		//
+		void InBox (Box3T<T> const& box, std::vector<size_t>& out) const {
+			SearchBox (box, 0, points.size (), out); }
+
+		// Batched k-nearest queries: results of query j go to idx[j*k] and
+		// dist[j*k], and the number found to found[j] when it is not null.
+		//
+		void KNearest (Vector3T<T> const* q, size_t m, size_t k, size_t* idx, T* dist, size_t* found = 0, batch::Policy const& p = batch::Policy ()) const {
+			batch::For (m, p, [this, q, k, idx, dist, found] (size_t b, size_t e) {
+				for (size_t j = b; j < e; ++j) {
+					size_t c = KNearest (q[j], k, idx + j*k, dist + j*k);
+					if (found) found[j] = c; } }); }
+
+	private:
+		struct Range {size_t lo, hi; Range (size_t lo, size_t hi) : lo(lo), hi(hi) {}};
+
+		struct Item {Vector3T<T> p; size_t i;};
+
+		// Picks the widest axis of [lo, hi), moves the median into place and
+		// returns its position.
+		//
+		size_t Partition (Item* items, size_t lo, size_t hi) {
+			Box3T<T> box = Box3T<T>::Empty ();
+			for (size_t i = lo; i < hi; ++i) box.Extend (items[i].p);
+			Vector3T<T> e = box.Extent ();
+			int a = (e.x >= e.y && e.x >= e.z) ? 0 : (e.y >= e.z ? 1 : 2);
+			size_t mid = lo + (hi - lo) / 2;
+			std::nth_element (items + lo, items + mid, items + hi, [a] (Item const& l, Item const& r) {
+				return detail::axis (l.p, a) < detail::axis (r.p, a); });
+			split[mid] = uint8_t (a);
+			return mid; }
+
+		void BuildRange (Item* items, size_t lo, size_t hi) {
+			if (hi - lo <= LeafSize) return;
+			size_t mid = Partition (items, lo, hi);
+			BuildRange (items, lo, mid);
+			BuildRange (items, mid + 1, hi); }
+
+		void SearchK (Vector3T<T> const& q, size_t lo, size_t hi, detail::Nearest<T>& best) const {
+			if (hi - lo <= LeafSize) {
+				for (size_t i = lo; i < hi; ++i) best.Insert (index[i], Vec::DistanceSq (q, points[i]));
+				return; }
+			size_t mid = lo + (hi - lo) / 2;
+			int a = split[mid];
+			T diff = detail::axis (q, a) - detail::axis (points[mid], a);
+			best.Insert (index[mid], Vec::DistanceSq (q, points[mid]));
+			if (diff < T(0)) {
+				SearchK (q, lo, mid, best);
+				if (diff*diff < best.Worst ()) SearchK (q, mid + 1, hi, best); }
+			else {
+				SearchK (q, mid + 1, hi, best);
+				if (diff*diff < best.Worst ()) SearchK (q, lo, mid, best); } }
+
+		void SearchRadius (Vector3T<T> const& q, T r2, size_t lo, size_t hi, std::vector<size_t>& out) const {
+			if (hi - lo <= LeafSize) {
+				for (size_t i = lo; i < hi; ++i) if (Vec::DistanceSq (q, points[i]) <= r2) out.push_back (index[i]);
+				return; }
+			size_t mid = lo + (hi - lo) / 2;
+			int a = split[mid];
+			T diff = detail::axis (q, a) - detail::axis (points[mid], a);
+			if (Vec::DistanceSq (q, points[mid]) <= r2) out.push_back (index[mid]);
+			if (diff <= T(0) || diff*diff <= r2) SearchRadius (q, r2, lo, mid, out);
+			if (diff >= T(0) || diff*diff <= r2) SearchRadius (q, r2, mid + 1, hi, out); }
+
+		void SearchBox (Box3T<T> const& box, size_t lo, size_t hi, std::vector<size_t>& out) const {
+			if (hi - lo <= LeafSize) {
+				for (size_t i = lo; i < hi; ++i) if (box.Contains (points[i])) out.push_back (index[i]);
+				return; }
+			size_t mid = lo + (hi - lo) / 2;
+			int a = split[mid];
+			T s = detail::axis (points[mid], a);
+			if (box.Contains (points[mid])) out.push_back (index[mid]);
+			if (detail::axis (box.min, a) <= s) SearchBox (box, lo, mid, out);
+			if (detail::axis (box.max, a) >= s) SearchBox (box, mid + 1, hi, out); }
+
+		std::vector<Vector3T<T> > points; // tree order
+		std::vector<size_t> index;        // original index of each point
+		std::vector<uint8_t> split;       // split axis, valid at node positions
+	};
+
+	// The FLOAT_TYPE tree.
+	//
+	typedef KdTreeT<Scalar> KdTree;
+}
+
+#endif // VEC_KDTREE_H
@@ -0,0 +1,111 @@
+#ifndef MATRIX3_H
+#define MATRIX3_H
+
+#include <cmath>
+#include <type_traits>
+
+#include "Vector3.h"
+
+// ************************************************************************************
+// Matrix3T structure - 3x3 matrix acting on column Vector3T vectors.
+//
+// Stored row-major, m[row][column]; M*v transforms v.
+//
+// ************************************************************************************
+//
+namespace Vec
+{
+	template <class T>
+	struct Matrix3T
+	{
+		typedef T Scalar;
+
+		T m[3][3];
+
+		// Constructors. Default construction leaves the matrix uninitialized
+		// like Vector3T.
+		//
+		Matrix3T () = default;
+		constexpr Matrix3T (T m00, T m01, T m02, T m10, T m11, T m12, T m20, T m21, T m22)
+			: m{{m00, m01, m02}, {m10, m11, m12}, {m20, m21, m22}} {}
+
+		// Explicit conversion between precisions.
+		//
+		template <class U>
+		explicit Matrix3T (Matrix3T<U> const& a) {
+			for (int i = 0; i < 3; ++i) for (int j = 0; j < 3; ++j) m[i][j] = T(a.m[i][j]); }
+
+		// Common matrices.
+		//
+		static Matrix3T Identity () {return Matrix3T (1, 0, 0, 0, 1, 0, 0, 0, 1);}
+		static Matrix3T Scale (Vector3T<T> const& s) {return Matrix3T (s.x, 0, 0, 0, s.y, 0, 0, 0, s.z);}
+		static Matrix3T FromRows (Vector3T<T> const& r0, Vector3T<T> const& r1, Vector3T<T> const& r2) {
+			return Matrix3T (r0.x, r0.y, r0.z, r1.x, r1.y, r1.z, r2.x, r2.y, r2.z); }
+		static Matrix3T FromColumns (Vector3T<T> const& c0, Vector3T<T> const& c1, Vector3T<T> const& c2) {
+			return Matrix3T (c0.x, c1.x, c2.x, c0.y, c1.y, c2.y, c0.z, c1.z, c2.z); }
+
+		// Rotation by angle radians (right-handed) about a unit axis.
+		//
+		static Matrix3T Rotation (Vector3T<T> const& axis, T angle) {
+			T c = std::cos (angle), s = std::sin (angle), t = T(1) - c;
+			T x = axis.x, y = axis.y, z = axis.z;
+			return Matrix3T (t*x*x + c,   t*x*y - s*z, t*x*z + s*y,
+			                 t*x*y + s*z, t*y*y + c,   t*y*z - s*x,
+			                 t*x*z - s*y, t*y*z + s*x, t*z*z + c); }
+
+		// Rows and columns.
+		//
+		Vector3T<T> Row (int i) const {return Vector3T<T> (m[i][0], m[i][1], m[i][2]);}
+		Vector3T<T> Column (int j) const {return Vector3T<T> (m[0][j], m[1][j], m[2][j]);}
+
+		// Operators.
+		//
+		// Non-constant.
+		//
+		Matrix3T& operator*= (T s) {for (int i = 0; i < 3; ++i) for (int j = 0; j < 3; ++j) m[i][j] *= s; return *this;}
+		Matrix3T& operator+= (Matrix3T const& a) {for (int i = 0; i < 3; ++i) for (int j = 0; j < 3; ++j) m[i][j] += a.m[i][j]; return *this;}
+		Matrix3T& operator-= (Matrix3T const& a) {for (int i = 0; i < 3; ++i) for (int j = 0; j < 3; ++j) m[i][j] -= a.m[i][j]; return *this;}
+		Matrix3T& operator*= (Matrix3T const& a) {*this = *this * a; return *this;}
+
+		// Constant.
+		//
+		Matrix3T operator* (T s) const {Matrix3T r(*this); r*=s; return r;}
+		Matrix3T operator+ (Matrix3T const& a) const {Matrix3T r(*this); r+=a; return r;}
+		Matrix3T operator- (Matrix3T const& a) const {Matrix3T r(*this); r-=a; return r;}
+		Matrix3T operator* (Matrix3T const& a) const {
+			Matrix3T r;
+			for (int i = 0; i < 3; ++i)
+				for (int j = 0; j < 3; ++j)
+					r.m[i][j] = m[i][0]*a.m[0][j] + m[i][1]*a.m[1][j] + m[i][2]*a.m[2][j];
+			return r; }
+		Vector3T<T> operator* (Vector3T<T> const& v) const {
+			return Vector3T<T> (m[0][0]*v.x + m[0][1]*v.y + m[0][2]*v.z,
+			                    m[1][0]*v.x + m[1][1]*v.y + m[1][2]*v.z,
+			                    m[2][0]*v.x + m[2][1]*v.y + m[2][2]*v.z); }
+
+		// Transpose, determinant and inverse (of a non-singular matrix).
+		//
+		Matrix3T Transpose () const {
+			return Matrix3T (m[0][0], m[1][0], m[2][0], m[0][1], m[1][1], m[2][1], m[0][2], m[1][2], m[2][2]); }
+
+		T Determinant () const {return Vec::Dot (Row (0), Vec::Cross (Row (1), Row (2)));}
+
+		Matrix3T Inverse () const {
+			Vector3T<T> c0 = Vec::Cross (Row (1), Row (2)), c1 = Vec::Cross (Row (2), Row (0)), c2 = Vec::Cross (Row (0), Row (1));
+			T d = T(1) / Vec::Dot (Row (0), c0);
+			return FromColumns (c0*d, c1*d, c2*d); }
+	};
+
+	// External operators for Matrix3T.
+	//
+	template <class T> inline
+	Matrix3T<T> operator* (typename Matrix3T<T>::Scalar s, Matrix3T<T> const& a) {return a * s;}
+
+	// The FLOAT_TYPE matrix.
+	//
+	typedef Matrix3T<Scalar> Matrix3;
+
+	static_assert (std::is_trivial<Matrix3>::value && sizeof (Matrix3) == 9 * sizeof (Scalar), "Matrix3 layout");
+}
+
+#endif // MATRIX3_H
@@ -0,0 +1,95 @@
+#ifndef MATRIX4_H
+#define MATRIX4_H
+
+#include <type_traits>
+
+#include "Vector3.h"
+#include "Matrix3.h"
+
+// ************************************************************************************
+// Matrix4T structure - 4x4 affine transform of Vector3T points and directions.
+//
+// Stored row-major, m[row][column]. The last row is kept at (0, 0, 0, 1); a
+// point p maps to Linear()*p + Translation() and a direction to Linear()*d.
+//
+// ************************************************************************************
+//
+namespace Vec
+{
+	template <class T>
+	struct Matrix4T
+	{
+		typedef T Scalar;
+
+		T m[4][4];
+
+		// Constructors. Default construction leaves the matrix uninitialized
+		// like Vector3T.
+		//
+		Matrix4T () = default;
+		constexpr Matrix4T (T m00, T m01, T m02, T m03, T m10, T m11, T m12, T m13, T m20, T m21, T m22, T m23)
+			: m{{m00, m01, m02, m03}, {m10, m11, m12, m13}, {m20, m21, m22, m23}, {0, 0, 0, 1}} {}
+
+		// The affine transform x -> a*x + t.
+		//
+		Matrix4T (Matrix3T<T> const& a, Vector3T<T> const& t)
+			: Matrix4T (a.m[0][0], a.m[0][1], a.m[0][2], t.x, a.m[1][0], a.m[1][1], a.m[1][2], t.y, a.m[2][0], a.m[2][1], a.m[2][2], t.z) {}
+
+		// Explicit conversion between precisions.
+		//
+		template <class U>
+		explicit Matrix4T (Matrix4T<U> const& a) {
+			for (int i = 0; i < 4; ++i) for (int j = 0; j < 4; ++j) m[i][j] = T(a.m[i][j]); }
+
+		// Common transforms.
+		//
+		static Matrix4T Identity () {return Matrix4T (Matrix3T<T>::Identity (), Vector3T<T> (T(0)));}
+		static Matrix4T Translation (Vector3T<T> const& t) {return Matrix4T (Matrix3T<T>::Identity (), t);}
+		static Matrix4T Scale (Vector3T<T> const& s) {return Matrix4T (Matrix3T<T>::Scale (s), Vector3T<T> (T(0)));}
+		static Matrix4T Rotation (Vector3T<T> const& axis, T angle) {return Matrix4T (Matrix3T<T>::Rotation (axis, angle), Vector3T<T> (T(0)));}
+
+		// The linear part and the translation.
+		//
+		Matrix3T<T> Linear () const {
+			return Matrix3T<T> (m[0][0], m[0][1], m[0][2], m[1][0], m[1][1], m[1][2], m[2][0], m[2][1], m[2][2]); }
+		Vector3T<T> Translation () const {return Vector3T<T> (m[0][3], m[1][3], m[2][3]);}
+
+		// Operators.
+		//
+		Matrix4T& operator*= (Matrix4T const& a) {*this = *this * a; return *this;}
+
+		// Composition: (A*B) applies B first.
+		//
+		Matrix4T operator* (Matrix4T const& a) const {
+			Matrix4T r;
+			for (int i = 0; i < 4; ++i)
+				for (int j = 0; j < 4; ++j)
+					r.m[i][j] = m[i][0]*a.m[0][j] + m[i][1]*a.m[1][j] + m[i][2]*a.m[2][j] + m[i][3]*a.m[3][j];
+			return r; }
+
+		// Transforms a point (translation applied) or a direction (not applied).
+		//
+		Vector3T<T> TransformPoint (Vector3T<T> const& p) const {
+			return Vector3T<T> (m[0][0]*p.x + m[0][1]*p.y + m[0][2]*p.z + m[0][3],
+			                    m[1][0]*p.x + m[1][1]*p.y + m[1][2]*p.z + m[1][3],
+			                    m[2][0]*p.x + m[2][1]*p.y + m[2][2]*p.z + m[2][3]); }
+		Vector3T<T> TransformDirection (Vector3T<T> const& d) const {
+			return Vector3T<T> (m[0][0]*d.x + m[0][1]*d.y + m[0][2]*d.z,
+			                    m[1][0]*d.x + m[1][1]*d.y + m[1][2]*d.z,
+			                    m[2][0]*d.x + m[2][1]*d.y + m[2][2]*d.z); }
+
+		// Inverse of an affine transform with a non-singular linear part.
+		//
+		Matrix4T Inverse () const {
+			Matrix3T<T> a = Linear ().Inverse ();
+			return Matrix4T (a, -(a * Translation ())); }
+	};
+
+	// The FLOAT_TYPE matrix.
+	//
+	typedef Matrix4T<Scalar> Matrix4;
+
+	static_assert (std::is_trivial<Matrix4>::value && sizeof (Matrix4) == 16 * sizeof (Scalar), "Matrix4 layout");
+}
+
+#endif // MATRIX4_H
@@ -0,0 +1,279 @@
+#ifndef VEC_PIPELINE_H
+#define VEC_PIPELINE_H
+
+#include <cstddef> // size_t
+#include <cstdio>
+#include <cstring>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Vector3.h"
+#include "Box3.h"
+#include "Vector3Batch.h"
+#include "Vector3Reduce.h"
+#include "Transform.h"
+#include "PointCloudFile.h"
+
+// ************************************************************************************
+// PipelineT class - Chunked streaming of Vector3T data through batch stages.
+//
+// Run pulls chunks of at most ChunkSize() points from a source, applies the
+// stages in order to each chunk in place and hands it to the sink. Reading
+// and writing run on their own threads and Buffers() chunks rotate between
+// them, so while chunk k is computed chunk k+1 is being read and chunk k-1
+// written: throughput is that of the slowest of the three instead of their
+// sum. Stages run on the calling thread and see chunks in order; they may
+// use a batch::Policy of their own to spread a chunk over a ThreadPool. An
+// exception from the source, a stage or the sink stops the run like an
+// error return and is rethrown by Run once both threads have finished.
+//
+// ************************************************************************************
+//
+namespace Vec
+{
+	template <class T>
+	class PipelineT
+	{
+	public:
+		// Fills v with up to max points: sets n (0 at the end) and returns
+		// false on an error.
+		//
+		typedef std::function<bool (Vector3T<T>* v, size_t max, size_t& n)> Source;
+
+		// Transforms the n points of a chunk in place; first is the index of
+		// v[0] in the whole stream.
+		//
+		typedef std::function<void (Vector3T<T>* v, size_t n, size_t first)> Stage;
+
+		// Consumes a chunk; returns false on an error.
+		//
+		typedef std::function<bool (Vector3T<T> const* v, size_t n)> Sink;
+
+		explicit PipelineT (size_t chunk = size_t(1) << 16, size_t buffers = 3) : chunk(chunk ? chunk : 1), buffers(buffers < 2 ? 2 : buffers) {}
+
+		size_t ChunkSize () const {return chunk;}
+		size_t Buffers () const {return buffers;}
+
+		// Appends a stage.
+		//
+		PipelineT& Then (Stage const& s) {stages.push_back (s); return *this;}
+
+		// Streams the source through the stages into the sink (which may be
+		// empty, e.g. when the last stage is a reduction). Returns false when
+		// the source or the sink failed; the remaining chunks are dropped.
+		//
+		bool Run (Source const& source, Sink const& sink = Sink ()) {
+			if (slots.size () != buffers) slots.assign (buffers, std::vector<Vector3T<T> > ());
+			for (size_t i = 0; i < buffers; ++i) slots[i].resize (chunk);
+			State s;
+			for (size_t i = 0; i < buffers; ++i) s.free.push_back (Item (i, 0, 0));
+			std::thread reader ([&] {Read (s, source);});
+			std::thread writer;
+			if (sink) writer = std::thread ([&] {Write (s, sink);});
+			try {
+				for (;;) {
+					Item it;
+					if (!s.Pop (s.full, it)) break;
+					if (it.slot != End)
+						for (size_t k = 0; k < stages.size (); ++k) stages[k] (slots[it.slot].data (), it.n, it.first);
+					if (!sink) {
+						if (it.slot == End) break;
+						it.n = 0; s.Push (s.free, it); }
+					else {
+						s.Push (s.done, it);
+						if (it.slot == End) break; } } }
+			catch (...) {s.Fail (std::current_exception ());}
+			reader.join ();
+			if (sink) writer.join ();
+			if (s.error) std::rethrow_exception (s.error);
+			return !s.failed; }
+
+	private:
+		static const size_t End = size_t(-1);
+
+		struct Item
+		{
+			size_t slot, n, first;
+			Item () : slot(End), n(0), first(0) {}
+			Item (size_t slot, size_t n, size_t first) : slot(slot), n(n), first(first) {}
+		};
+
+		// Queues of chunk slots between the threads.
+		//
+		struct State
+		{
+			std::mutex mutex;
+			std::condition_variable cv;
+			std::deque<Item> free, full, done;
+			bool failed;
+			std::exception_ptr error; // the first exception; read after the joins
+
+			State () : failed(false) {}
+
+			void Push (std::deque<Item>& q, Item const& it) {
+				{std::lock_guard<std::mutex> lock (mutex); q.push_back (it);}
+				cv.notify_all (); }
+
+			// Waits for an item; false once the run has failed.
+			//
+			bool Pop (std::deque<Item>& q, Item& it) {
+				std::unique_lock<std::mutex> lock (mutex);
+				cv.wait (lock, [&] {return failed || !q.empty ();});
+				if (failed) return false;
+				it = q.front (); q.pop_front ();
+				return true; }
+
+			void Fail (std::exception_ptr e = std::exception_ptr ()) {
+				{
+					std::lock_guard<std::mutex> lock (mutex);
+					failed = true;
+					if (e && !error) error = e;
+				}
+				cv.notify_all (); }
+		};
+
+		void Read (State& s, Source const& source) {
+			size_t first = 0;
+			for (;;) {
+				Item it;
+				if (!s.Pop (s.free, it)) return;
+				size_t n = 0;
+				bool ok;
+				try {ok = source (slots[it.slot].data (), chunk, n);}
+				catch (...) {s.Fail (std::current_exception ()); return;}
+				if (!ok) {s.Fail (); return;}
+				if (n == 0) {s.Push (s.full, Item ()); return;}
+				s.Push (s.full, Item (it.slot, n, first));
+				first += n; } }
+
+		void Write (State& s, Sink const& sink) {
+			for (;;) {
+				Item it;
+				if (!s.Pop (s.done, it) || it.slot == End) return;
+				bool ok;
+				try {ok = sink (slots[it.slot].data (), it.n);}
+				catch (...) {s.Fail (std::current_exception ()); return;}
+				if (!ok) {s.Fail (); return;}
+				it.n = 0;
+				s.Push (s.free, it); } }
+
+		size_t chunk, buffers;
+		std::vector<Stage> stages;
+		std::vector<std::vector<Vector3T<T> > > slots;
+	};
+
+	// The FLOAT_TYPE pipeline.
+	//
+	typedef PipelineT<Scalar> Pipeline;
+}
+
+
+// ************************************************************************************
+// PointCloudReaderT class - Sequential reader of AoS point cloud files.
+//
+// Reads the points of a file written by PointCloudWriterT with plain
+// buffered I/O, for files too large to map or on file systems where
+// mapping is slow. Source() adapts it to a pipeline.
+//
+// ************************************************************************************
+//
+namespace Vec
+{
+	template <class T>
+	class PointCloudReaderT
+	{
+	public:
+		PointCloudReaderT () : file(0), left(0) {}
+		~PointCloudReaderT () {Close ();}
+
+		// Opens a file of AoS points of type T.
+		//
+		bool Open (char const* path) {
+			Close ();
+			file = std::fopen (path, "rb");
+			if (!file) return false;
+			PointCloudHeader h;
+			bool ok = std::fread (&h, sizeof h, 1, file) == 1
+				&& std::memcmp (h.magic, "VEC3PCF", 8) == 0 && h.version == PointCloudHeader::CurrentVersion
+				&& h.byteOrder == PointCloudHeader::ByteOrder && h.scalarSize == sizeof (T) && h.layout == PointCloudAoS
+				&& std::fseek (file, long (h.dataOffset), SEEK_SET) == 0;
+			if (!ok) {Close (); return false;}
+			left = h.count;
+			return true; }
+
+		void Close () {
+			if (file) std::fclose (file);
+			file = 0; left = 0; }
+
+		// Points not yet read.
+		//
+		uint64_t Remaining () const {return left;}
+
+		// Reads up to max points; false on an I/O error.
+		//
+		bool Read (Vector3T<T>* v, size_t max, size_t& n) {
+			n = 0;
+			if (!file) return false;
+			size_t want = left < max ? size_t (left) : max;
+			n = std::fread (v, sizeof (Vector3T<T>), want, file);
+			left -= n;
+			return n == want; }
+
+		typename PipelineT<T>::Source Source () {
+			return [this] (Vector3T<T>* v, size_t max, size_t& n) {return Read (v, max, n);}; }
+
+	private:
+		PointCloudReaderT (PointCloudReaderT const&);
+		PointCloudReaderT& operator= (PointCloudReaderT const&);
+
+		std::FILE* file;
+		uint64_t left;
+	};
+}
+
+
+// ************************************************************************************
+// Vec::stage namespace - Batch kernels as pipeline stages.
+//
+// Reductions accumulate into a caller's variable over the whole stream.
+//
+// ************************************************************************************
+//
+namespace Vec
+{
+namespace stage
+{
+	template <class T> inline
+	typename PipelineT<T>::Stage Normalize (batch::Policy const& p = batch::Policy ()) {
+		return [=] (Vector3T<T>* v, size_t n, size_t) {batch::Normalize (v, n, p);}; }
+
+	template <class T> inline
+	typename PipelineT<T>::Stage TransformPoints (Matrix4T<T> const& m, batch::Policy const& p = batch::Policy ()) {
+		return [=] (Vector3T<T>* v, size_t n, size_t) {Vec::TransformPoints (m, v, v, n, p);}; }
+
+	template <class T> inline
+	typename PipelineT<T>::Stage TransformDirections (Matrix4T<T> const& m, batch::Policy const& p = batch::Policy ()) {
+		return [=] (Vector3T<T>* v, size_t n, size_t) {Vec::TransformDirections (m, v, v, n, p);}; }
+
+	// Adds every chunk's sum to sum (which the caller zeroes).
+	//
+	template <class T> inline
+	typename PipelineT<T>::Stage Sum (Vector3T<T>& sum, batch::Policy const& p = batch::Policy ()) {
+		Vector3T<T>* s = &sum;
+		return [=] (Vector3T<T>* v, size_t n, size_t) {*s += Vec::Sum (v, n, p);}; }
+
+	// Extends box (which the caller empties) by every chunk.
+	//
+	template <class T> inline
+	typename PipelineT<T>::Stage Bounds (Box3T<T>& box, batch::Policy const& p = batch::Policy ()) {
+		Box3T<T>* b = &box;
+		return [=] (Vector3T<T>* v, size_t n, size_t) {b->Extend (Vec::Bounds (v, n, p));}; }
+}
+}
+
+#endif // VEC_PIPELINE_H
@@ -0,0 +1,313 @@
+#ifndef VEC_POINT_CLOUD_FILE_H
+#define VEC_POINT_CLOUD_FILE_H
+
+#include <cstddef> // size_t
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <type_traits>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+	#define VEC_HAS_MMAP
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+#include "Vector3.h"
+#include "Vector3SoA.h"
+#include "Box3.h"
+
+// ************************************************************************************
+// Point cloud files - Binary container of Vector3T arrays.
+//
+// Layout, all in host byte order (the header records it and readers reject
+// a mismatch):
+//
+//   0                PointCloudHeader (64 bytes)
+//   dataOffset       the points: AoS, count Vector3T<T> records, or SoA,
+//                    the x, y and z streams each padded to 64 bytes
+//   indexOffset      optional chunk index: one Box3T<T> per chunkSize
+//                    points, bounding those points
+//
+// T is float or double (scalarSize 4 or 8). The data starts on a 64 byte
+// boundary, so a mapped file can be used in place: PointCloudFile hands out
+// pointers straight into the mapping and nothing is parsed or copied.
+//
+// ************************************************************************************
+//
+namespace Vec
+{
+	enum PointCloudLayout {PointCloudAoS = 0, PointCloudSoA = 1};
+
+	struct PointCloudHeader
+	{
+		// Format identification.
+		//
+		static const uint32_t CurrentVersion = 1;
+		static const uint32_t ByteOrder = 0x01020304;
+
+		char magic[8];        // "VEC3PCF" and a zero
+		uint32_t version;     // CurrentVersion
+		uint32_t byteOrder;   // ByteOrder as written by the host
+		uint64_t count;       // number of points
+		uint64_t dataOffset;  // start of the points
+		uint64_t chunkSize;   // points per index entry, 0 without an index
+		uint64_t indexOffset; // start of the chunk index
+		uint8_t scalarSize;   // sizeof (T)
+		uint8_t layout;       // PointCloudLayout
+		uint8_t reserved[14];
+
+		// A header for count points, without an index.
+		//
+		template <class T>
+		static PointCloudHeader Make (uint64_t count, PointCloudLayout layout) {
+			PointCloudHeader h;
+			std::memset (&h, 0, sizeof h);
+			std::memcpy (h.magic, "VEC3PCF", 8);
+			h.version = CurrentVersion; h.byteOrder = ByteOrder;
+			h.count = count; h.dataOffset = sizeof h;
+			h.scalarSize = uint8_t (sizeof (T)); h.layout = uint8_t (layout);
+			return h; }
+
+		// Size in bytes of the point data; SoA streams are padded to 64 bytes.
+		//
+		uint64_t StreamBytes () const {return (count * scalarSize + 63) / 64 * 64;}
+		uint64_t DataBytes () const {return layout == PointCloudSoA ? 3 * StreamBytes () : 3 * count * scalarSize;}
+		uint64_t Chunks () const {return chunkSize ? (count + chunkSize - 1) / chunkSize : 0;}
+	};
+
+	static_assert (sizeof (PointCloudHeader) == 64 && std::is_trivial<PointCloudHeader>::value, "PointCloudHeader layout");
+}
+
+
+// ************************************************************************************
+// PointCloudWriterT class - Streams AoS points into a point cloud file.
+//
+// Points may be appended in any number of Write calls; Close writes the
+// chunk index and the final header. All functions return false on an I/O
+// error, after which the file is incomplete.
+//
+// ************************************************************************************
+//
+namespace Vec
+{
+	template <class T>
+	class PointCloudWriterT
+	{
+	public:
+		PointCloudWriterT () : file(0), ok(false) {}
+		~PointCloudWriterT () {Close ();}
+
+		// Creates the file; chunkSize 0 writes no index.
+		//
+		bool Open (char const* path, size_t chunkSize = 0) {
+			Close ();
+			file = std::fopen (path, "wb");
+			if (!file) return false;
+			header = PointCloudHeader::Make<T> (0, PointCloudAoS);
+			header.chunkSize = chunkSize;
+			index.clear ();
+			ok = std::fwrite (&header, sizeof header, 1, file) == 1;
+			return ok; }
+
+		bool IsOpen () const {return file != 0;}
+
+		// Appends n points.
+		//
+		bool Write (Vector3T<T> const* v, size_t n) {
+			if (!file || !ok) return false;
+			if (header.chunkSize) {
+				for (size_t i = 0; i < n; ++i) {
+					if (header.count % header.chunkSize == 0) index.push_back (Box3T<T>::Empty ());
+					index.back ().Extend (v[i]);
+					++header.count; } }
+			else header.count += n;
+			ok = std::fwrite (v, sizeof (Vector3T<T>), n, file) == n;
+			return ok; }
+
+		// Finishes the file. Returns whether everything was written.
+		//
+		bool Close () {
+			if (!file) return false;
+			if (ok && header.chunkSize) {
+				header.indexOffset = header.dataOffset + header.DataBytes ();
+				ok = std::fwrite (index.data (), sizeof (Box3T<T>), index.size (), file) == index.size (); }
+			ok = ok && std::fseek (file, 0, SEEK_SET) == 0 && std::fwrite (&header, sizeof header, 1, file) == 1;
+			ok = (std::fclose (file) == 0) && ok;
+			file = 0;
+			return ok; }
+
+	private:
+		PointCloudWriterT (PointCloudWriterT const&);
+		PointCloudWriterT& operator= (PointCloudWriterT const&);
+
+		std::FILE* file;
+		bool ok;
+		PointCloudHeader header;
+		std::vector<Box3T<T> > index;
+	};
+
+	// Writes n AoS points in one go.
+	//
+	template <class T> inline
+	bool WritePointCloud (char const* path, Vector3T<T> const* v, size_t n, size_t chunkSize = 0) {
+		PointCloudWriterT<T> w;
+		return w.Open (path, chunkSize) && w.Write (v, n) && w.Close (); }
+
+	// Writes a Vector3SoAT as SoA streams.
+	//
+	template <class T> inline
+	bool WritePointCloud (char const* path, Vector3SoAT<T> const& v, size_t chunkSize = 0) {
+		PointCloudHeader h = PointCloudHeader::Make<T> (v.Size (), PointCloudSoA);
+		h.chunkSize = chunkSize;
+		std::vector<Box3T<T> > index (h.Chunks (), Box3T<T>::Empty ());
+		if (chunkSize) {
+			for (size_t i = 0; i < v.Size (); ++i) index[i / chunkSize].Extend (v.Get (i));
+			h.indexOffset = h.dataOffset + h.DataBytes (); }
+		std::FILE* f = std::fopen (path, "wb");
+		if (!f) return false;
+		static const char zeros[64] = {};
+		size_t const pad = size_t (h.StreamBytes () - v.Size () * sizeof (T));
+		bool ok = std::fwrite (&h, sizeof h, 1, f) == 1;
+		T const* s[3] = {v.X (), v.Y (), v.Z ()};
+		for (int a = 0; a < 3 && ok; ++a)
+			ok = std::fwrite (s[a], sizeof (T), v.Size (), f) == v.Size () && std::fwrite (zeros, 1, pad, f) == pad;
+		ok = ok && std::fwrite (index.data (), sizeof (Box3T<T>), index.size (), f) == index.size ();
+		return (std::fclose (f) == 0) && ok; }
+}
+
+
+// ************************************************************************************
+// PointCloudFile class - Read-only view of a point cloud file.
+//
+// Open maps the file (POSIX mmap; elsewhere it is read into one aligned
+// buffer) and validates the header. The accessors return pointers into the
+// mapping, valid until Close, or null when the file holds another scalar
+// type or layout. With populate the pages are faulted in by Open instead of
+// on first touch.
+//
+// ************************************************************************************
+//
+namespace Vec
+{
+	class PointCloudFile
+	{
+	public:
+		PointCloudFile () : base(0), bytes(0) {std::memset (&header, 0, sizeof header);}
+		~PointCloudFile () {Close ();}
+
+		// Opens and validates a file; false when it cannot be read or is not
+		// a well-formed point cloud of this host's byte order.
+		//
+		bool Open (char const* path, bool populate = false) {
+			Close ();
+			if (!Map (path, populate)) return false;
+			if (bytes < sizeof header) {Close (); return false;}
+			std::memcpy (&header, base, sizeof header);
+			if (!Valid ()) {Close (); return false;}
+			return true; }
+
+		void Close () {
+			Unmap ();
+			base = 0; bytes = 0;
+			std::memset (&header, 0, sizeof header); }
+
+		bool IsOpen () const {return base != 0;}
+
+		// Contents.
+		//
+		PointCloudHeader const& Header () const {return header;}
+		size_t Size () const {return size_t (header.count);}
+		size_t ScalarSize () const {return header.scalarSize;}
+		PointCloudLayout Layout () const {return PointCloudLayout (header.layout);}
+
+		// The points of an AoS file.
+		//
+		template <class T>
+		Vector3T<T> const* Points () const {
+			return IsType<T> (PointCloudAoS) ? reinterpret_cast<Vector3T<T> const*> (base + header.dataOffset) : 0; }
+
+		// The streams of an SoA file.
+		//
+		template <class T> T const* X () const {return Stream<T> (0);}
+		template <class T> T const* Y () const {return Stream<T> (1);}
+		template <class T> T const* Z () const {return Stream<T> (2);}
+
+		// The chunk index: Chunks() boxes, each bounding ChunkSize() points.
+		//
+		size_t ChunkSize () const {return size_t (header.chunkSize);}
+		size_t Chunks () const {return size_t (header.Chunks ());}
+		template <class T>
+		Box3T<T> const* ChunkBounds () const {
+			return header.chunkSize && header.scalarSize == sizeof (T) ? reinterpret_cast<Box3T<T> const*> (base + header.indexOffset) : 0; }
+
+	private:
+		PointCloudFile (PointCloudFile const&);
+		PointCloudFile& operator= (PointCloudFile const&);
+
+		template <class T>
+		bool IsType (PointCloudLayout l) const {return base && header.scalarSize == sizeof (T) && header.layout == l;}
+
+		template <class T>
+		T const* Stream (int a) const {
+			return IsType<T> (PointCloudSoA) ? reinterpret_cast<T const*> (base + header.dataOffset + a * header.StreamBytes ()) : 0; }
+
+		bool Valid () const {
+			PointCloudHeader const& h = header;
+			if (std::memcmp (h.magic, "VEC3PCF", 8) != 0 || h.version != PointCloudHeader::CurrentVersion) return false;
+			if (h.byteOrder != PointCloudHeader::ByteOrder) return false;
+			if ((h.scalarSize != 4 && h.scalarSize != 8) || h.layout > PointCloudSoA) return false;
+			if (h.dataOffset % 64 != 0 || h.count > (uint64_t(-1) / 4) / h.scalarSize) return false;
+			if (h.dataOffset > bytes || h.DataBytes () > bytes - h.dataOffset) return false;
+			if (h.chunkSize) {
+				uint64_t ib = h.Chunks () * 6 * h.scalarSize;
+				if (h.indexOffset % h.scalarSize != 0 || h.indexOffset > bytes || ib > bytes - h.indexOffset) return false; }
+			return true; }
+
+#ifdef VEC_HAS_MMAP
+		bool Map (char const* path, bool populate) {
+			int fd = ::open (path, O_RDONLY);
+			if (fd < 0) return false;
+			struct stat st;
+			if (::fstat (fd, &st) != 0 || st.st_size <= 0) {::close (fd); return false;}
+			int flags = MAP_PRIVATE;
+	#ifdef MAP_POPULATE
+			if (populate) flags |= MAP_POPULATE;
+	#endif
+			void* p = ::mmap (0, size_t (st.st_size), PROT_READ, flags, fd, 0);
+			::close (fd);
+			if (p == MAP_FAILED) return false;
+			base = static_cast<char const*> (p); bytes = size_t (st.st_size);
+			if (!populate) ::madvise (p, bytes, MADV_SEQUENTIAL);
+			return true; }
+
+		void Unmap () {if (base) ::munmap (const_cast<char*> (base), bytes);}
+#else
+		bool Map (char const* path, bool) {
+			std::FILE* f = std::fopen (path, "rb");
+			if (!f) return false;
+			std::fseek (f, 0, SEEK_END);
+			long n = std::ftell (f);
+			std::fseek (f, 0, SEEK_SET);
+			if (n <= 0) {std::fclose (f); return false;}
+			char* p = static_cast<char*> (AlignedAlloc (size_t (n), SoAAlignment));
+			bool ok = std::fread (p, 1, size_t (n), f) == size_t (n);
+			std::fclose (f);
+			if (!ok) {AlignedFree (p); return false;}
+			base = p; bytes = size_t (n);
+			return true; }
+
+		void Unmap () {AlignedFree (const_cast<char*> (base));}
+#endif
+
+		char const* base;
+		size_t bytes;
+		PointCloudHeader header;
+	};
+}
+
+#endif // VEC_POINT_CLOUD_FILE_H
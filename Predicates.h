@@ -0,0 +1,263 @@
+#ifndef VEC_PREDICATES_H
+#define VEC_PREDICATES_H
+
+#include <cmath>
+#include <vector>
+
+#include "Vector3.h"
+
+// Keeps the exact fallbacks out of line so the filters inline at the call.
+//
+#if defined(__GNUC__) || defined(__clang__)
+	#define VEC_NOINLINE __attribute__ ((noinline))
+#elif defined(_MSC_VER)
+	#define VEC_NOINLINE __declspec (noinline)
+#else
+	#define VEC_NOINLINE
+#endif
+
+// ************************************************************************************
+// Vec namespace - Robust orientation and insphere predicates.
+//
+// Orient3D and InSphere return a value whose sign is always correct, after
+// Shewchuk's adaptive predicates: the determinant is first evaluated in
+// doubles with a forward error bound, and recomputed in exact expansion
+// arithmetic only when the bound cannot decide the sign. Most calls cost a
+// Dot of a Cross plus a few absolute values. When InSphere's differences to
+// e are exact, as they are for grid coordinates, its fallback works on them
+// on the stack; otherwise it expands the 5x5 determinant on the heap.
+//
+// The inputs are converted to double, which is exact for float and double
+// but rounds long double. The error bounds assume IEEE double arithmetic in
+// round-to-nearest, so the predicates are not robust on x87 builds that
+// keep doubles in extended registers (use SSE2).
+//
+// ************************************************************************************
+//
+namespace Vec
+{
+	namespace detail
+	{
+		// Machine epsilon of the bounds (half an ulp of 1) and the error
+		// bound coefficients of the double filters.
+		//
+		const double PredicateEpsilon = 1.1102230246251565e-16;
+		const double Orient3DBound = (7.0 + 56.0 * PredicateEpsilon) * PredicateEpsilon;
+		const double InSphereBound = (16.0 + 224.0 * PredicateEpsilon) * PredicateEpsilon;
+
+		// Error-free transformations: x is the rounded result and y its error.
+		//
+		inline void fast_two_sum (double a, double b, double& x, double& y) {x = a + b; y = b - (x - a);}
+
+		inline void two_sum (double a, double b, double& x, double& y) {
+			x = a + b;
+			double bv = x - a, av = x - bv;
+			y = (a - av) + (b - bv); }
+
+		inline void two_diff (double a, double b, double& x, double& y) {
+			x = a - b;
+			double bv = a - x, av = x + bv;
+			y = (a - av) + (bv - b); }
+
+#if defined(FP_FAST_FMA) || defined(__FMA__)
+		inline void two_product (double a, double b, double& x, double& y) {x = a * b; y = std::fma (a, b, -x);}
+#else
+		// Dekker's product; without hardware FMA nothing can be contracted.
+		//
+		inline void split (double a, double& hi, double& lo) {
+			double c = 134217729.0 * a; // 2^27 + 1
+			hi = c - (c - a); lo = a - hi; }
+
+		inline void two_product (double a, double b, double& x, double& y) {
+			x = a * b;
+			double ah, al, bh, bl;
+			split (a, ah, al); split (b, bh, bl);
+			y = al*bl - (((x - ah*bh) - al*bh) - ah*bl); }
+#endif
+
+		// Expansions are arrays of nonoverlapping doubles in increasing
+		// magnitude whose sum is the exact value; the last component has
+		// its sign. Both functions drop zero components and return the
+		// length of h, which holds at least elen + flen or 2 elen doubles.
+		//
+		inline int expansion_sum (int elen, double const* e, int flen, double const* f, double* h) {
+			int ei = 0, fi = 0, hi = 0;
+			double en = e[0], fn = f[0], q, qn, hh;
+			if ((fn > en) == (fn > -en)) {q = en; en = ++ei < elen ? e[ei] : 0;}
+			else {q = fn; fn = ++fi < flen ? f[fi] : 0;}
+			if (ei < elen && fi < flen) {
+				if ((fn > en) == (fn > -en)) {fast_two_sum (en, q, qn, hh); en = ++ei < elen ? e[ei] : 0;}
+				else {fast_two_sum (fn, q, qn, hh); fn = ++fi < flen ? f[fi] : 0;}
+				q = qn;
+				if (hh != 0) h[hi++] = hh;
+				while (ei < elen && fi < flen) {
+					if ((fn > en) == (fn > -en)) {two_sum (q, en, qn, hh); en = ++ei < elen ? e[ei] : 0;}
+					else {two_sum (q, fn, qn, hh); fn = ++fi < flen ? f[fi] : 0;}
+					q = qn;
+					if (hh != 0) h[hi++] = hh; } }
+			while (ei < elen) {two_sum (q, en, qn, hh); en = ++ei < elen ? e[ei] : 0; q = qn; if (hh != 0) h[hi++] = hh;}
+			while (fi < flen) {two_sum (q, fn, qn, hh); fn = ++fi < flen ? f[fi] : 0; q = qn; if (hh != 0) h[hi++] = hh;}
+			if (q != 0 || hi == 0) h[hi++] = q;
+			return hi; }
+
+		inline int expansion_scale (int elen, double const* e, double b, double* h) {
+			int hi = 0;
+			double q, hh, p1, p0, s;
+			two_product (e[0], b, q, hh);
+			if (hh != 0) h[hi++] = hh;
+			for (int i = 1; i < elen; ++i) {
+				two_product (e[i], b, p1, p0);
+				two_sum (q, p0, s, hh);
+				if (hh != 0) h[hi++] = hh;
+				fast_two_sum (p1, s, q, hh);
+				if (hh != 0) h[hi++] = hh; }
+			if (q != 0 || hi == 0) h[hi++] = q;
+			return hi; }
+
+		// px*qy - qx*py (4 components).
+		//
+		inline int minor2 (double px, double py, double qx, double qy, double* h) {
+			double e[2], f[2];
+			two_product (px, qy, e[1], e[0]);
+			two_product (qx, py, f[1], f[0]);
+			f[0] = -f[0]; f[1] = -f[1];
+			return expansion_sum (2, e, 2, f, h); }
+
+		// sa*a + sb*b + sc*c for 4-component a, b and c (24 components).
+		//
+		inline int combine3 (double sa, double const* a, int alen, double sb, double const* b, int blen, double sc, double const* c, int clen, double* h) {
+			double ta[8], tb[8], tc[8], ab[16];
+			int na = expansion_scale (alen, a, sa, ta), nb = expansion_scale (blen, b, sb, tb), nc = expansion_scale (clen, c, sc, tc);
+			int nab = expansion_sum (na, ta, nb, tb, ab);
+			return expansion_sum (nab, ab, nc, tc, h); }
+
+		// s*(x*x + y*y + z*z)*e for an e of at most N components (12 N).
+		//
+		template <int N> inline
+		int lift (double const* e, int elen, double s, double x, double y, double z, double* h) {
+			double t[2*N], u[4*N], v[4*N], w[8*N];
+			int nt = expansion_scale (elen, e, s*x, t), nu = expansion_scale (nt, t, x, u);
+			nt = expansion_scale (elen, e, s*y, t); int nv = expansion_scale (nt, t, y, v);
+			int nw = expansion_sum (nu, u, nv, v, w);
+			nt = expansion_scale (elen, e, s*z, t); nu = expansion_scale (nt, t, z, u);
+			return expansion_sum (nw, w, nu, u, h); }
+
+		// The determinant of the rows (x, y, z, 1) of a, b, c and d, exactly
+		// (96 components).
+		//
+		inline int orient3d_exact (Vector3T<double> const& a, Vector3T<double> const& b, Vector3T<double> const& c, Vector3T<double> const& d, double* h) {
+			double ab[4], bc[4], cd[4], da[4], ac[4], bd[4];
+			int nab = minor2 (a.x, a.y, b.x, b.y, ab), nbc = minor2 (b.x, b.y, c.x, c.y, bc), ncd = minor2 (c.x, c.y, d.x, d.y, cd);
+			int nda = minor2 (d.x, d.y, a.x, a.y, da), nac = minor2 (a.x, a.y, c.x, c.y, ac), nbd = minor2 (b.x, b.y, d.x, d.y, bd);
+			// Expansion along z: az*(bc + cd - bd) - bz*(ac + cd + da) + cz*(ab + bd + da) - dz*(ab + bc - ac).
+			double ma[24], mb[24], mc[24], md[24], s1[48], s2[48];
+			int na = combine3 (a.z, bc, nbc, a.z, cd, ncd, -a.z, bd, nbd, ma);
+			int nb = combine3 (-b.z, ac, nac, -b.z, cd, ncd, -b.z, da, nda, mb);
+			int nc = combine3 (c.z, ab, nab, c.z, bd, nbd, c.z, da, nda, mc);
+			int nd = combine3 (-d.z, ab, nab, -d.z, bc, nbc, d.z, ac, nac, md);
+			int n1 = expansion_sum (na, ma, nb, mb, s1), n2 = expansion_sum (nc, mc, nd, md, s2);
+			return expansion_sum (n1, s1, n2, s2, h); }
+
+		VEC_NOINLINE inline double orient3d_adapt (Vector3T<double> const& a, Vector3T<double> const& b, Vector3T<double> const& c, Vector3T<double> const& d) {
+			double h[96];
+			int n = orient3d_exact (a, b, c, d, h);
+			return h[n - 1]; }
+
+		// The insphere determinant of differences to e; exact when every
+		// difference is (1152 components).
+		//
+		inline double insphere_relative (double const* x, double const* y, double const* z) {
+			double ab[4], bc[4], cd[4], da[4], ac[4], bd[4];
+			int nab = minor2 (x[0], y[0], x[1], y[1], ab), nbc = minor2 (x[1], y[1], x[2], y[2], bc), ncd = minor2 (x[2], y[2], x[3], y[3], cd);
+			int nda = minor2 (x[3], y[3], x[0], y[0], da), nac = minor2 (x[0], y[0], x[2], y[2], ac), nbd = minor2 (x[1], y[1], x[3], y[3], bd);
+			double abc[24], bcd[24], cda[24], dab[24];
+			int nabc = combine3 (z[0], bc, nbc, -z[1], ac, nac, z[2], ab, nab, abc);
+			int nbcd = combine3 (z[1], cd, ncd, -z[2], bd, nbd, z[3], bc, nbc, bcd);
+			int ncda = combine3 (z[2], da, nda, z[3], ac, nac, z[0], cd, ncd, cda);
+			int ndab = combine3 (z[3], ab, nab, z[0], bd, nbd, z[1], da, nda, dab);
+			// (dlift*abc - clift*dab) + (blift*cda - alift*bcd).
+			double t[4][288], s1[576], s2[576], h[1152];
+			int n0 = lift<24> (abc, nabc, 1, x[3], y[3], z[3], t[0]), n1 = lift<24> (dab, ndab, -1, x[2], y[2], z[2], t[1]);
+			int n2 = lift<24> (cda, ncda, 1, x[1], y[1], z[1], t[2]), n3 = lift<24> (bcd, nbcd, -1, x[0], y[0], z[0], t[3]);
+			int m1 = expansion_sum (n0, t[0], n1, t[1], s1), m2 = expansion_sum (n2, t[2], n3, t[3], s2);
+			int n = expansion_sum (m1, s1, m2, s2, h);
+			return h[n - 1]; }
+
+		// The determinant of the rows (x, y, z, x*x + y*y + z*z, 1) of the
+		// five points, exactly (5760 components). Expanded along the lift
+		// column, whose cofactors are orientations of the other four points.
+		//
+		inline double insphere_exact (Vector3T<double> const* p) {
+			std::vector<double> acc (5760), sum (5760), t (1152);
+			int n = 1; acc[0] = 0;
+			for (int i = 0; i < 5; ++i) {
+				Vector3T<double> q[4];
+				for (int j = 0, k = 0; j < 5; ++j) if (j != i) q[k++] = p[j];
+				double o[96];
+				int no = orient3d_exact (q[0], q[1], q[2], q[3], o);
+				int nt = lift<96> (o, no, (i & 1) ? 1 : -1, p[i].x, p[i].y, p[i].z, &t[0]);
+				n = expansion_sum (n, &acc[0], nt, &t[0], &sum[0]);
+				acc.swap (sum); }
+			return acc[n - 1]; }
+
+		VEC_NOINLINE inline double insphere_adapt (Vector3T<double> const* p) {
+			double x[4], y[4], z[4], tx, ty, tz;
+			bool exact = true;
+			for (int i = 0; i < 4; ++i) {
+				two_diff (p[i].x, p[4].x, x[i], tx); two_diff (p[i].y, p[4].y, y[i], ty); two_diff (p[i].z, p[4].z, z[i], tz);
+				exact = exact && tx == 0 && ty == 0 && tz == 0; }
+			return exact ? insphere_relative (x, y, z) : insphere_exact (p); }
+	}
+
+	// Positive when d lies below the plane through a, b and c, which appear
+	// counterclockwise from above; negative above and zero when coplanar.
+	// The value approximates Dot (a - d, Cross (b - d, c - d)).
+	//
+	template <class T> inline
+	double Orient3D (Vector3T<T> const& pa, Vector3T<T> const& pb, Vector3T<T> const& pc, Vector3T<T> const& pd) {
+		double adx = double (pa.x) - double (pd.x), bdx = double (pb.x) - double (pd.x), cdx = double (pc.x) - double (pd.x);
+		double ady = double (pa.y) - double (pd.y), bdy = double (pb.y) - double (pd.y), cdy = double (pc.y) - double (pd.y);
+		double adz = double (pa.z) - double (pd.z), bdz = double (pb.z) - double (pd.z), cdz = double (pc.z) - double (pd.z);
+		double bdxcdy = bdx*cdy, cdxbdy = cdx*bdy, cdxady = cdx*ady, adxcdy = adx*cdy, adxbdy = adx*bdy, bdxady = bdx*ady;
+		double det = adz*(bdxcdy - cdxbdy) + bdz*(cdxady - adxcdy) + cdz*(adxbdy - bdxady);
+		double permanent = (std::fabs (bdxcdy) + std::fabs (cdxbdy)) * std::fabs (adz)
+			+ (std::fabs (cdxady) + std::fabs (adxcdy)) * std::fabs (bdz)
+			+ (std::fabs (adxbdy) + std::fabs (bdxady)) * std::fabs (cdz);
+		double bound = detail::Orient3DBound * permanent;
+		if (det > bound || -det > bound) return det;
+		return detail::orient3d_adapt (Vector3T<double> (pa), Vector3T<double> (pb), Vector3T<double> (pc), Vector3T<double> (pd)); }
+
+	// Positive when e lies inside the sphere through a, b, c and d, negative
+	// outside and zero on it, provided Orient3D (a, b, c, d) is positive;
+	// the sign flips otherwise.
+	//
+	template <class T> inline
+	double InSphere (Vector3T<T> const& pa, Vector3T<T> const& pb, Vector3T<T> const& pc, Vector3T<T> const& pd, Vector3T<T> const& pe) {
+		Vector3T<double> const p[5] = {Vector3T<double> (pa), Vector3T<double> (pb), Vector3T<double> (pc), Vector3T<double> (pd), Vector3T<double> (pe)};
+		double aex = p[0].x - p[4].x, bex = p[1].x - p[4].x, cex = p[2].x - p[4].x, dex = p[3].x - p[4].x;
+		double aey = p[0].y - p[4].y, bey = p[1].y - p[4].y, cey = p[2].y - p[4].y, dey = p[3].y - p[4].y;
+		double aez = p[0].z - p[4].z, bez = p[1].z - p[4].z, cez = p[2].z - p[4].z, dez = p[3].z - p[4].z;
+		double aexbey = aex*bey, bexaey = bex*aey, bexcey = bex*cey, cexbey = cex*bey;
+		double cexdey = cex*dey, dexcey = dex*cey, dexaey = dex*aey, aexdey = aex*dey;
+		double aexcey = aex*cey, cexaey = cex*aey, bexdey = bex*dey, dexbey = dex*bey;
+		double ab = aexbey - bexaey, bc = bexcey - cexbey, cd = cexdey - dexcey;
+		double da = dexaey - aexdey, ac = aexcey - cexaey, bd = bexdey - dexbey;
+		double abc = aez*bc - bez*ac + cez*ab, bcd = bez*cd - cez*bd + dez*bc;
+		double cda = cez*da + dez*ac + aez*cd, dab = dez*ab + aez*bd + bez*da;
+		double alift = aex*aex + aey*aey + aez*aez, blift = bex*bex + bey*bey + bez*bez;
+		double clift = cex*cex + cey*cey + cez*cez, dlift = dex*dex + dey*dey + dez*dez;
+		double det = (dlift*abc - clift*dab) + (blift*cda - alift*bcd);
+		double aez_ = std::fabs (aez), bez_ = std::fabs (bez), cez_ = std::fabs (cez), dez_ = std::fabs (dez);
+		double pab = std::fabs (aexbey) + std::fabs (bexaey), pbc = std::fabs (bexcey) + std::fabs (cexbey);
+		double pcd = std::fabs (cexdey) + std::fabs (dexcey), pda = std::fabs (dexaey) + std::fabs (aexdey);
+		double pac = std::fabs (aexcey) + std::fabs (cexaey), pbd = std::fabs (bexdey) + std::fabs (dexbey);
+		double permanent = (pcd*bez_ + pbd*cez_ + pbc*dez_) * alift
+			+ (pda*cez_ + pac*dez_ + pcd*aez_) * blift
+			+ (pab*dez_ + pbd*aez_ + pda*bez_) * clift
+			+ (pbc*aez_ + pac*bez_ + pab*cez_) * dlift;
+		double bound = detail::InSphereBound * permanent;
+		if (det > bound || -det > bound) return det;
+		return detail::insphere_adapt (p); }
+}
+
+#endif // VEC_PREDICATES_H
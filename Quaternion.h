@@ -0,0 +1,127 @@
+#ifndef QUATERNION_H
+#define QUATERNION_H
+
+#include <cmath>
+#include <type_traits>
+
+#include "Vector3.h"
+#include "Matrix3.h"
+
+// ************************************************************************************
+// QuaternionT structure - Rotation quaternion w + xi + yj + zk.
+//
+// Rotations expect unit quaternions; q*r applies r first.
+//
+// ************************************************************************************
+//
+namespace Vec
+{
+	template <class T>
+	struct QuaternionT
+	{
+		typedef T Scalar;
+
+		T w, x, y, z;
+
+		// Constructors.
+		//
+		QuaternionT () = default;
+		constexpr QuaternionT (T w, T x, T y, T z) : w(w), x(x), y(y), z(z) {}
+		constexpr QuaternionT (T w, Vector3T<T> const& v) : w(w), x(v.x), y(v.y), z(v.z) {}
+
+		// Explicit conversion between precisions.
+		//
+		template <class U>
+		constexpr explicit QuaternionT (QuaternionT<U> const& q) : w(T(q.w)), x(T(q.x)), y(T(q.y)), z(T(q.z)) {}
+
+		// The identity rotation.
+		//
+		static QuaternionT Identity () {return QuaternionT (T(1), T(0), T(0), T(0));}
+
+		// Rotation by angle radians (right-handed) about a unit axis.
+		//
+		static QuaternionT FromAxisAngle (Vector3T<T> const& axis, T angle) {
+			T h = T(0.5) * angle;
+			return QuaternionT (std::cos (h), axis * std::sin (h)); }
+
+		// Rotation of an orthonormal matrix (Shepperd's method).
+		//
+		static QuaternionT FromMatrix (Matrix3T<T> const& r) {
+			T const (&m)[3][3] = r.m;
+			T t = m[0][0] + m[1][1] + m[2][2];
+			if (t > T(0)) {
+				T s = std::sqrt (t + T(1)) * T(2);
+				return QuaternionT (T(0.25)*s, (m[2][1]-m[1][2])/s, (m[0][2]-m[2][0])/s, (m[1][0]-m[0][1])/s); }
+			if (m[0][0] > m[1][1] && m[0][0] > m[2][2]) {
+				T s = std::sqrt (T(1) + m[0][0] - m[1][1] - m[2][2]) * T(2);
+				return QuaternionT ((m[2][1]-m[1][2])/s, T(0.25)*s, (m[0][1]+m[1][0])/s, (m[0][2]+m[2][0])/s); }
+			if (m[1][1] > m[2][2]) {
+				T s = std::sqrt (T(1) + m[1][1] - m[0][0] - m[2][2]) * T(2);
+				return QuaternionT ((m[0][2]-m[2][0])/s, (m[0][1]+m[1][0])/s, T(0.25)*s, (m[1][2]+m[2][1])/s); }
+			T s = std::sqrt (T(1) + m[2][2] - m[0][0] - m[1][1]) * T(2);
+			return QuaternionT ((m[1][0]-m[0][1])/s, (m[0][2]+m[2][0])/s, (m[1][2]+m[2][1])/s, T(0.25)*s); }
+
+		// The vector part.
+		//
+		Vector3T<T> Vector () const {return Vector3T<T> (x, y, z);}
+
+		// Operators.
+		//
+		QuaternionT& operator*= (QuaternionT const& q) {*this = *this * q; return *this;}
+		QuaternionT operator* (QuaternionT const& q) const {
+			return QuaternionT (w*q.w - x*q.x - y*q.y - z*q.z,
+			                    w*q.x + x*q.w + y*q.z - z*q.y,
+			                    w*q.y - x*q.z + y*q.w + z*q.x,
+			                    w*q.z + x*q.y - y*q.x + z*q.w); }
+		QuaternionT operator- () const {return QuaternionT (-w, -x, -y, -z);}
+
+		// Length and normalization.
+		//
+		T LengthSq () const {return w*w + x*x + y*y + z*z;}
+		T Length () const {return std::sqrt (LengthSq ());}
+		T Normalize () {T m = Length (); T mi = T(1)/m; w*=mi; x*=mi; y*=mi; z*=mi; return m;}
+
+		// Conjugate, which is the inverse of a unit quaternion.
+		//
+		QuaternionT Conjugate () const {return QuaternionT (w, -x, -y, -z);}
+
+		// Rotates a vector: v + 2w(u x v) + 2u x (u x v) with u the vector part.
+		//
+		Vector3T<T> Rotate (Vector3T<T> const& v) const {
+			Vector3T<T> u = Vector (), t = Vec::Cross (u, v) * T(2);
+			return v + t * w + Vec::Cross (u, t); }
+
+		// The equivalent rotation matrix.
+		//
+		Matrix3T<T> ToMatrix () const {
+			T xx = x*x, yy = y*y, zz = z*z, xy = x*y, xz = x*z, yz = y*z, wx = w*x, wy = w*y, wz = w*z;
+			return Matrix3T<T> (T(1) - T(2)*(yy+zz), T(2)*(xy-wz), T(2)*(xz+wy),
+			                    T(2)*(xy+wz), T(1) - T(2)*(xx+zz), T(2)*(yz-wx),
+			                    T(2)*(xz-wy), T(2)*(yz+wx), T(1) - T(2)*(xx+yy)); }
+	};
+
+	// Spherical linear interpolation between unit quaternions along the
+	// shorter arc.
+	//
+	template <class T> inline
+	QuaternionT<T> Slerp (QuaternionT<T> const& a, QuaternionT<T> const& b, T t) {
+		T d = a.w*b.w + a.x*b.x + a.y*b.y + a.z*b.z;
+		QuaternionT<T> c = d < T(0) ? -b : b;
+		d = std::fabs (d);
+		T ka, kb;
+		if (d > T(0.9995)) {ka = T(1) - t; kb = t;}
+		else {
+			T th = std::acos (d), s = T(1)/std::sin (th);
+			ka = std::sin ((T(1) - t)*th) * s; kb = std::sin (t*th) * s; }
+		QuaternionT<T> r (ka*a.w + kb*c.w, ka*a.x + kb*c.x, ka*a.y + kb*c.y, ka*a.z + kb*c.z);
+		r.Normalize ();
+		return r; }
+
+	// The FLOAT_TYPE quaternion.
+	//
+	typedef QuaternionT<Scalar> Quaternion;
+
+	static_assert (std::is_trivial<Quaternion>::value && sizeof (Quaternion) == 4 * sizeof (Scalar), "Quaternion layout");
+}
+
+#endif // QUATERNION_H
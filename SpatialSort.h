@@ -0,0 +1,279 @@
+#ifndef VEC_SPATIAL_SORT_H
+#define VEC_SPATIAL_SORT_H
+
+#include <cstddef> // size_t
+#include <cstdint>
+#include <cstring> // memcpy
+#include <vector>
+
+#include "Vector3.h"
+#include "Box3.h"
+#include "Vector3Batch.h"
+#include "Vector3Reduce.h"
+#include "Arena.h"
+
+// Bit deposit for the key interleaving (-mbmi2). Slow on AMD before Zen 3,
+// where the shift-and-mask fallback is faster; define VECTOR3_NO_PDEP to
+// use the fallback on BMI2 builds.
+//
+#if defined(__BMI2__) && (defined(__x86_64__) || defined(_M_X64)) && !defined(VECTOR3_NO_PDEP)
+	#define VECTOR3_HAS_BMI2
+	#include <immintrin.h>
+#endif
+
+// ************************************************************************************
+// Vec namespace - Morton and Hilbert keys of Vector3T points.
+//
+// A key quantizes each coordinate to KeyBits bits within a box and
+// interleaves them into 63 bits; points outside the box are clamped to it
+// and NaN coordinates go to its minimum. Morton (Z-order) keys take bit i
+// of x, y and z as key bits 3i, 3i+1 and 3i+2. Hilbert keys follow
+// Skilling's transform of the same cell coordinates: cells with consecutive
+// keys are face neighbours, which Morton order does not guarantee.
+//
+// ************************************************************************************
+//
+namespace Vec
+{
+	// Bits per axis of a key.
+	//
+	const int KeyBits = 21;
+
+	enum Curve {CurveMorton, CurveHilbert};
+
+	namespace detail
+	{
+		// The low 21 bits of x moved to every third bit.
+		//
+		inline uint64_t spread3 (uint64_t x) {
+#ifdef VECTOR3_HAS_BMI2
+			return _pdep_u64 (x, 0x1249249249249249ull);
+#else
+			x &= 0x1fffff;
+			x = (x | x << 32) & 0x1f00000000ffffull;
+			x = (x | x << 16) & 0x1f0000ff0000ffull;
+			x = (x | x << 8) & 0x100f00f00f00f00full;
+			x = (x | x << 4) & 0x10c30c30c30c30c3ull;
+			return (x | x << 2) & 0x1249249249249249ull;
+#endif
+		}
+
+		// Cell coordinates of points in a box.
+		//
+		template <class T>
+		struct key_grid
+		{
+			T ox, oy, oz, sx, sy, sz;
+
+			explicit key_grid (Box3T<T> const& box) : ox(box.min.x), oy(box.min.y), oz(box.min.z) {
+				T const cells = T(uint32_t(1) << KeyBits);
+				Vector3T<T> e = box.max - box.min;
+				sx = e.x > T(0) ? cells / e.x : T(0);
+				sy = e.y > T(0) ? cells / e.y : T(0);
+				sz = e.z > T(0) ? cells / e.z : T(0); }
+
+			static uint32_t cell (T v, T o, T s) {
+				T const top = T((uint32_t(1) << KeyBits) - 1);
+				T q = (v - o) * s;
+				return q > T(0) ? (q < top ? uint32_t (q) : uint32_t (top)) : 0; }
+
+			void operator() (Vector3T<T> const& v, uint32_t& x, uint32_t& y, uint32_t& z) const {
+				x = cell (v.x, ox, sx); y = cell (v.y, oy, sy); z = cell (v.z, oz, sz); }
+		};
+	}
+
+	// The Morton key of KeyBits-bit cell coordinates.
+	//
+	inline uint64_t MortonEncode (uint32_t x, uint32_t y, uint32_t z) {
+		return detail::spread3 (x) | detail::spread3 (y) << 1 | detail::spread3 (z) << 2; }
+
+	// The Hilbert key of KeyBits-bit cell coordinates.
+	//
+	inline uint64_t HilbertEncode (uint32_t x, uint32_t y, uint32_t z) {
+		uint32_t c0 = x, c1 = y, c2 = z, t = 0;
+		// Skilling's axes-to-transpose, branch-free: from the top bit b down,
+		// the bits of c0 below b are inverted where c[i] has b set and
+		// swapped with those of c[i] where it has not; then the Gray code.
+		for (int b = KeyBits - 1; b > 0; --b) {
+			uint32_t const p = (uint32_t(1) << b) - 1;
+			uint32_t m = 0 - ((c0 >> b) & 1);
+			c0 ^= p & m;
+			m = 0 - ((c1 >> b) & 1);
+			c0 ^= p & m; t = (c0 ^ c1) & p & ~m; c0 ^= t; c1 ^= t;
+			m = 0 - ((c2 >> b) & 1);
+			c0 ^= p & m; t = (c0 ^ c2) & p & ~m; c0 ^= t; c2 ^= t; }
+		c1 ^= c0; c2 ^= c1;
+		t = 0;
+		for (int b = KeyBits - 1; b > 0; --b) t ^= ((uint32_t(1) << b) - 1) & (0 - ((c2 >> b) & 1));
+		c0 ^= t; c1 ^= t; c2 ^= t;
+		// The transposed index: x holds the most significant bit of each triple.
+		return detail::spread3 (c2) | detail::spread3 (c1) << 1 | detail::spread3 (c0) << 2; }
+
+	// Keys of a point in box.
+	//
+	template <class T> inline
+	uint64_t MortonKey (Vector3T<T> const& v, Box3T<T> const& box) {
+		detail::key_grid<T> const g (box);
+		uint32_t x, y, z; g (v, x, y, z);
+		return MortonEncode (x, y, z); }
+
+	template <class T> inline
+	uint64_t HilbertKey (Vector3T<T> const& v, Box3T<T> const& box) {
+		detail::key_grid<T> const g (box);
+		uint32_t x, y, z; g (v, x, y, z);
+		return HilbertEncode (x, y, z); }
+}
+
+
+// ************************************************************************************
+// Vec::batch namespace - Key generation, radix sort and reordering.
+//
+// SortByKey is a stable least-significant-digit radix sort of 64-bit keys
+// in 11-bit digits, skipping digits that are equal in every key. Under a
+// pool the array is cut into a few blocks per thread that are counted and
+// scattered in parallel; the result does not depend on the thread count.
+// It needs 2n keys and indices of scratch, from the Arena when one is given.
+// Permute applies the resulting order to points or any payload array, and
+// SpatialSort does all of it for a point array.
+//
+// ************************************************************************************
+//
+namespace Vec
+{
+namespace batch
+{
+	namespace detail
+	{
+		const int RadixBits = 11;
+		const size_t RadixSize = size_t(1) << RadixBits;
+
+		// n uninitialized R from the arena when there is one, else the heap.
+		//
+		template <class R>
+		struct buffer
+		{
+			std::vector<R> own;
+			Arena* arena;
+			Arena::Marker mark;
+			R* data;
+
+			buffer (size_t n, Arena* arena) : arena(arena) {
+				if (arena) {mark = arena->Mark (); data = arena->Allocate<R> (n);}
+				else {own.resize (n); data = own.data ();} }
+			~buffer () {if (arena) arena->Release (mark);}
+		};
+	}
+
+	// Morton or Hilbert keys of n points in box.
+	//
+	template <class T> inline
+	void MortonKeys (Vector3T<T> const* v, size_t n, Box3T<T> const& box, uint64_t* keys, Policy const& p = Policy ()) {
+		Vec::detail::key_grid<T> const g (box);
+		For (n, p, [=, &g] (size_t b, size_t e) {
+			for (size_t i = b; i < e; ++i) {
+				uint32_t x, y, z; g (v[i], x, y, z);
+				keys[i] = MortonEncode (x, y, z); } }); }
+
+	template <class T> inline
+	void HilbertKeys (Vector3T<T> const* v, size_t n, Box3T<T> const& box, uint64_t* keys, Policy const& p = Policy ()) {
+		Vec::detail::key_grid<T> const g (box);
+		For (n, p, [=, &g] (size_t b, size_t e) {
+			for (size_t i = b; i < e; ++i) {
+				uint32_t x, y, z; g (v[i], x, y, z);
+				keys[i] = HilbertEncode (x, y, z); } }); }
+
+	// Sorts n keys ascending and stably; order[i] receives the original
+	// index of the key now at i.
+	//
+	inline void SortByKey (uint64_t* keys, size_t n, size_t* order, Policy const& p = Policy (), Arena* scratch = 0) {
+		if (n == 0) return;
+		size_t const R = detail::RadixSize, passes = (64 + detail::RadixBits - 1) / detail::RadixBits;
+		size_t blocks = p.pool ? p.pool->Size () * 4 : 1;
+		if (blocks > n / 4096) blocks = n / 4096 ? n / 4096 : 1;
+		size_t const span = (n + blocks - 1) / (blocks ? blocks : 1);
+		Policy each (p); each.chunk = 1;
+		detail::buffer<uint64_t> tk (n, scratch);
+		detail::buffer<size_t> to (n, scratch);
+		detail::buffer<size_t> count (blocks * R, scratch);
+
+		// Digits in which the keys differ.
+		uint64_t all = 0, any = 0;
+		{
+			detail::buffer<uint64_t> a (2 * blocks, scratch);
+			uint64_t* const ab = a.data;
+			For (blocks, each, [=] (size_t cb, size_t ce) {
+				for (size_t c = cb; c < ce; ++c) {
+					uint64_t x = ~uint64_t(0), o = 0;
+					for (size_t i = c * span, e = (i + span < n) ? i + span : n; i < e; ++i) {x &= keys[i]; o |= keys[i];}
+					ab[2*c] = x; ab[2*c+1] = o; } });
+			all = ~uint64_t(0);
+			for (size_t c = 0; c < blocks; ++c) {all &= ab[2*c]; any |= ab[2*c+1];}
+		}
+		uint64_t const varying = all ^ any;
+
+		uint64_t* src = keys; uint64_t* dst = tk.data;
+		size_t* isrc = 0; size_t* idst = to.data;
+		for (size_t pass = 0; pass < passes; ++pass) {
+			int const shift = int (pass) * detail::RadixBits;
+			if (!((varying >> shift) & (R - 1))) continue;
+			size_t* const cnt = count.data;
+			// Count every block, then turn the counts into start offsets in
+			// digit-major, block-minor order, which keeps the sort stable.
+			For (blocks, each, [=] (size_t cb, size_t ce) {
+				for (size_t c = cb; c < ce; ++c) {
+					size_t* h = cnt + c * R;
+					std::memset (h, 0, R * sizeof (size_t));
+					for (size_t i = c * span, e = (i + span < n) ? i + span : n; i < e; ++i) ++h[(src[i] >> shift) & (R - 1)]; } });
+			size_t sum = 0;
+			for (size_t d = 0; d < R; ++d)
+				for (size_t c = 0; c < blocks; ++c) {size_t t = cnt[c * R + d]; cnt[c * R + d] = sum; sum += t;}
+			uint64_t const* const s = src; uint64_t* const k = dst;
+			size_t const* const is = isrc; size_t* const id = idst;
+			For (blocks, each, [=] (size_t cb, size_t ce) {
+				for (size_t c = cb; c < ce; ++c) {
+					size_t* h = cnt + c * R;
+					for (size_t i = c * span, e = (i + span < n) ? i + span : n; i < e; ++i) {
+						size_t o = h[(s[i] >> shift) & (R - 1)]++;
+						k[o] = s[i]; id[o] = is ? is[i] : i; } } });
+			src = dst; dst = (dst == keys) ? tk.data : keys;
+			isrc = idst; idst = (idst == order) ? to.data : order; }
+
+		if (!isrc) {
+			// Every key is equal.
+			For (n, p, [=] (size_t b, size_t e) {for (size_t i = b; i < e; ++i) order[i] = i;});
+			return; }
+		if (src != keys) {
+			uint64_t const* const s = src; size_t const* const is = isrc;
+			For (n, p, [=] (size_t b, size_t e) {
+				std::memcpy (keys + b, s + b, (e - b) * sizeof (uint64_t));
+				std::memcpy (order + b, is + b, (e - b) * sizeof (size_t)); }); } }
+
+	// out[i] = in[order[i]]; out may not alias in.
+	//
+	template <class U> inline
+	void Permute (U const* in, size_t const* order, size_t n, U* out, Policy const& p = Policy ()) {
+		For (n, p, [=] (size_t b, size_t e) {
+			for (size_t i = b; i < e; ++i) out[i] = in[order[i]]; }); }
+
+	// Reorders n points along curve within their bounds. order, which may be
+	// null, receives the original index of every point for Permute-ing the
+	// payload arrays.
+	//
+	template <class T> inline
+	void SpatialSort (Vector3T<T>* v, size_t n, size_t* order = 0, Curve curve = CurveHilbert, Policy const& p = Policy (), Arena* scratch = 0) {
+		if (n == 0) return;
+		Box3T<T> const box = Vec::Bounds (v, n, p, scratch);
+		detail::buffer<uint64_t> keys (n, scratch);
+		detail::buffer<size_t> own (order ? 0 : n, scratch);
+		size_t* const o = order ? order : own.data;
+		if (curve == CurveMorton) MortonKeys (v, n, box, keys.data, p);
+		else HilbertKeys (v, n, box, keys.data, p);
+		SortByKey (keys.data, n, o, p, scratch);
+		detail::buffer<Vector3T<T> > copy (n, scratch);
+		Vector3T<T>* const c = copy.data;
+		For (n, p, [=] (size_t b, size_t e) {std::memcpy (c + b, v + b, (e - b) * sizeof (Vector3T<T>));});
+		Permute (c, o, n, v, p); }
+}
+}
+
+#endif // VEC_SPATIAL_SORT_H
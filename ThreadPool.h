@@ -0,0 +1,193 @@
+#ifndef VEC_THREAD_POOL_H
+#define VEC_THREAD_POOL_H
+
+#include <cstddef> // size_t
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+	#include <pthread.h>
+	#include <sched.h>
+#endif
+
+// ************************************************************************************
+// ThreadPool class - Fixed set of worker threads for the Vec batch functions.
+//
+// ParallelFor splits [0, n) into one contiguous slice per participant (the
+// workers plus the calling thread). Each participant consumes its own slice
+// chunk by chunk and then steals remaining chunks from the other slices, so
+// uneven work still balances. With pinning enabled participant i always runs
+// on CPU i and gets the same slice on every call of the same size, so pages
+// first touched by a pinned pass stay on that thread's NUMA node. The
+// calling thread is pinned to the last CPU for the duration of each call and
+// gets its previous affinity back on return.
+//
+// An exception thrown by fn on any participant stops the remaining chunks and
+// is rethrown by ParallelFor once every participant has returned; when
+// several throw, the first one is kept.
+//
+// ************************************************************************************
+//
+namespace Vec
+{
+	class ThreadPool
+	{
+	public:
+		// Starts threads-1 workers (the caller is the last participant). Zero
+		// picks std::thread::hardware_concurrency.
+		//
+		explicit ThreadPool (size_t threads = 0, bool pin = false) : job(0), chunk(1), pin(pin), failed(false), stop(false), generation(0), pending(0) {
+			if (threads == 0) threads = std::thread::hardware_concurrency ();
+			if (threads == 0) threads = 1;
+			slices = std::vector<Slice> (threads);
+			for (size_t i = 0; i + 1 < threads; ++i) {
+				workers.push_back (std::thread (&ThreadPool::Run, this, i));
+				if (pin) Pin (workers.back (), i); } }
+
+		~ThreadPool () {
+			{std::lock_guard<std::mutex> lock (mutex); stop = true;}
+			wake.notify_all ();
+			for (size_t i = 0; i < workers.size (); ++i) workers[i].join (); }
+
+		// Number of participants, including the calling thread.
+		//
+		size_t Size () const {return slices.size ();}
+
+		// Calls fn(begin, end) over chunks of at most chunk indices covering
+		// [0, n) and returns when all of them are done. Calls from several
+		// threads at once are serialized. A call from inside a job of the same
+		// pool (a worker, or the caller's own slice) runs serially on that
+		// thread.
+		//
+		void ParallelFor (size_t n, size_t chunk, std::function<void (size_t, size_t)> const& fn) {
+			if (n == 0) return;
+			if (chunk == 0) chunk = 1;
+			if (workers.empty () || n <= chunk || Current () == this) {fn (0, n); return;}
+			std::lock_guard<std::mutex> call (calls);
+			Inside inside (this);
+			size_t const p = slices.size ();
+			PinCaller pinned (pin, p - 1);
+			for (size_t i = 0; i < p; ++i) {
+				slices[i].next.store (n * i / p, std::memory_order_relaxed);
+				slices[i].end = n * (i + 1) / p; }
+			this->chunk = chunk;
+			failed.store (false, std::memory_order_relaxed);
+			{
+				std::lock_guard<std::mutex> lock (mutex);
+				job = &fn;
+				pending = workers.size ();
+				++generation;
+			}
+			wake.notify_all ();
+			Work (p - 1);
+			std::unique_lock<std::mutex> lock (mutex);
+			done.wait (lock, [this] {return pending == 0;});
+			job = 0;
+			if (error) {
+				std::exception_ptr e = error; error = std::exception_ptr ();
+				lock.unlock ();
+				std::rethrow_exception (e); } }
+
+	private:
+		// One participant's share of the index range.
+		//
+		struct Slice {
+			std::atomic<size_t> next; size_t end;
+			Slice () : next(0), end(0) {}
+			Slice (Slice const&) : next(0), end(0) {} };
+
+		// The pool whose job this thread is running, if any.
+		//
+		static ThreadPool*& Current () {
+			thread_local ThreadPool* pool = 0;
+			return pool; }
+
+		struct Inside {
+			ThreadPool* previous;
+			explicit Inside (ThreadPool* p) : previous(Current ()) {Current () = p;}
+			~Inside () {Current () = previous;} };
+
+		static void Pin (std::thread& t, size_t cpu) {
+#ifdef __linux__
+			cpu_set_t set; CPU_ZERO (&set); CPU_SET (cpu % CPU_SETSIZE, &set);
+			pthread_setaffinity_np (t.native_handle (), sizeof set, &set);
+#else
+			(void) t; (void) cpu;
+#endif
+		}
+
+		// Pins the calling thread to cpu while in scope.
+		//
+		struct PinCaller {
+#ifdef __linux__
+			cpu_set_t saved; bool restore;
+			PinCaller (bool pin, size_t cpu) : restore(false) {
+				if (!pin) return;
+				restore = pthread_getaffinity_np (pthread_self (), sizeof saved, &saved) == 0;
+				cpu_set_t set; CPU_ZERO (&set); CPU_SET (cpu % CPU_SETSIZE, &set);
+				pthread_setaffinity_np (pthread_self (), sizeof set, &set); }
+			~PinCaller () {if (restore) pthread_setaffinity_np (pthread_self (), sizeof saved, &saved);}
+#else
+			PinCaller (bool, size_t) {}
+#endif
+		};
+
+		// Runs the current job: own slice first, then the others.
+		//
+		void Work (size_t self) {
+			size_t const p = slices.size ();
+			for (size_t k = 0; k < p; ++k) {
+				Slice& s = slices[(self + k) % p];
+				for (;;) {
+					if (failed.load (std::memory_order_relaxed)) return;
+					size_t b = s.next.fetch_add (chunk, std::memory_order_relaxed);
+					if (b >= s.end) break;
+					size_t e = (s.end - b < chunk) ? s.end : b + chunk;
+					try {(*job) (b, e);}
+					catch (...) {
+						std::lock_guard<std::mutex> lock (mutex);
+						if (!error) error = std::current_exception ();
+						failed.store (true, std::memory_order_relaxed);
+						return; } } } }
+
+		void Run (size_t self) {
+			Current () = this;
+			size_t seen = 0;
+			for (;;) {
+				{
+					std::unique_lock<std::mutex> lock (mutex);
+					wake.wait (lock, [&] {return stop || generation != seen;});
+					if (stop) return;
+					seen = generation;
+				}
+				Work (self);
+				std::lock_guard<std::mutex> lock (mutex);
+				if (--pending == 0) done.notify_one (); } }
+
+		std::vector<std::thread> workers;
+		std::vector<Slice> slices;
+		std::function<void (size_t, size_t)> const* job;
+		size_t chunk;
+		bool pin;
+		std::atomic<bool> failed;
+		std::exception_ptr error; // guarded by mutex
+
+		std::mutex mutex, calls;
+		std::condition_variable wake, done;
+		bool stop;
+		size_t generation, pending;
+	};
+
+	// Process-wide pool sized to the machine, created on first use.
+	//
+	inline ThreadPool& DefaultPool () {
+		static ThreadPool pool;
+		return pool; }
+}
+
+#endif // VEC_THREAD_POOL_H
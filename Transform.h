@@ -0,0 +1,122 @@
+#ifndef VEC_TRANSFORM_H
+#define VEC_TRANSFORM_H
+
+#include <cstddef> // size_t
+#include <cassert>
+
+#include "Vector3.h"
+#include "Vector3SoA.h"
+#include "Vector3Batch.h"
+#include "Matrix3.h"
+#include "Matrix4.h"
+#include "Quaternion.h"
+
+// ************************************************************************************
+// Vec namespace - Batch transforms of Vector3T arrays.
+//
+// The matrix is copied into locals before the loop so it stays in registers
+// while the vectors stream through; AoS input may be transformed in place,
+// SoA output is resized to the input. AoS functions take a batch::Policy to
+// run chunks on a ThreadPool.
+//
+// ************************************************************************************
+//
+namespace Vec
+{
+	namespace detail
+	{
+		// Matrix entries as locals; t is zero for directions.
+		//
+		template <class T>
+		struct Affine3
+		{
+			T a00, a01, a02, a10, a11, a12, a20, a21, a22, t0, t1, t2;
+
+			Affine3 (Matrix3T<T> const& m)
+				: a00(m.m[0][0]), a01(m.m[0][1]), a02(m.m[0][2]), a10(m.m[1][0]), a11(m.m[1][1]), a12(m.m[1][2])
+				, a20(m.m[2][0]), a21(m.m[2][1]), a22(m.m[2][2]), t0(0), t1(0), t2(0) {}
+			Affine3 (Matrix4T<T> const& m, bool point)
+				: a00(m.m[0][0]), a01(m.m[0][1]), a02(m.m[0][2]), a10(m.m[1][0]), a11(m.m[1][1]), a12(m.m[1][2])
+				, a20(m.m[2][0]), a21(m.m[2][1]), a22(m.m[2][2])
+				, t0(point ? m.m[0][3] : T(0)), t1(point ? m.m[1][3] : T(0)), t2(point ? m.m[2][3] : T(0)) {}
+
+			void Apply (Vector3T<T> const* in, Vector3T<T>* out, size_t b, size_t e) const {
+				Affine3 const k (*this);
+				for (size_t i = b; i < e; ++i) {
+					T x = in[i].x, y = in[i].y, z = in[i].z;
+					out[i].x = k.a00*x + k.a01*y + k.a02*z + k.t0;
+					out[i].y = k.a10*x + k.a11*y + k.a12*z + k.t1;
+					out[i].z = k.a20*x + k.a21*y + k.a22*z + k.t2; } }
+
+			void Apply (Vector3SoAT<T> const& in, Vector3SoAT<T>& out) const {
+				if (&out != &in) out.Resize (in.Size ());
+				VEC_SOA_STREAMS (i, in, const); VEC_SOA_STREAMS (o, out, );
+				Affine3 const k (*this); size_t const n = in.Size ();
+				if (&out == &in) {
+					for (size_t j = 0; j < n; ++j) {
+						T x = ox[j], y = oy[j], z = oz[j];
+						ox[j] = k.a00*x + k.a01*y + k.a02*z + k.t0;
+						oy[j] = k.a10*x + k.a11*y + k.a12*z + k.t1;
+						oz[j] = k.a20*x + k.a21*y + k.a22*z + k.t2; }
+					return; }
+				for (size_t j = 0; j < n; ++j) {
+					T x = ix[j], y = iy[j], z = iz[j];
+					ox[j] = k.a00*x + k.a01*y + k.a02*z + k.t0;
+					oy[j] = k.a10*x + k.a11*y + k.a12*z + k.t1;
+					oz[j] = k.a20*x + k.a21*y + k.a22*z + k.t2; } }
+		};
+
+		template <class T> inline
+		void transform (Affine3<T> const& k, Vector3T<T> const* in, Vector3T<T>* out, size_t n, batch::Policy const& p) {
+			batch::For (n, p, [&] (size_t b, size_t e) {k.Apply (in, out, b, e);}); }
+	}
+
+	// Transforms n points (translation applied); in may equal out.
+	//
+	template <class T> inline
+	void TransformPoints (Matrix4T<T> const& m, Vector3T<T> const* in, Vector3T<T>* out, size_t n, batch::Policy const& p = batch::Policy ()) {
+		VECTOR3_TIME (OpTransformPoints, n);
+		detail::transform (detail::Affine3<T> (m, true), in, out, n, p); }
+
+	template <class T> inline
+	void TransformPoints (Matrix4T<T> const& m, Vector3SoAT<T> const& in, Vector3SoAT<T>& out) {
+		VECTOR3_TIME (OpTransformPoints, in.Size ());
+		detail::Affine3<T> (m, true).Apply (in, out); }
+
+	// Transforms n directions (translation ignored); in may equal out.
+	//
+	template <class T> inline
+	void TransformDirections (Matrix4T<T> const& m, Vector3T<T> const* in, Vector3T<T>* out, size_t n, batch::Policy const& p = batch::Policy ()) {
+		VECTOR3_TIME (OpTransformDirections, n);
+		detail::transform (detail::Affine3<T> (m, false), in, out, n, p); }
+
+	template <class T> inline
+	void TransformDirections (Matrix3T<T> const& m, Vector3T<T> const* in, Vector3T<T>* out, size_t n, batch::Policy const& p = batch::Policy ()) {
+		VECTOR3_TIME (OpTransformDirections, n);
+		detail::transform (detail::Affine3<T> (m), in, out, n, p); }
+
+	template <class T> inline
+	void TransformDirections (Matrix4T<T> const& m, Vector3SoAT<T> const& in, Vector3SoAT<T>& out) {
+		VECTOR3_TIME (OpTransformDirections, in.Size ());
+		detail::Affine3<T> (m, false).Apply (in, out); }
+
+	template <class T> inline
+	void TransformDirections (Matrix3T<T> const& m, Vector3SoAT<T> const& in, Vector3SoAT<T>& out) {
+		VECTOR3_TIME (OpTransformDirections, in.Size ());
+		detail::Affine3<T> (m).Apply (in, out); }
+
+	// Rotates n vectors by a unit quaternion (through its matrix, which is
+	// cheaper per vector than QuaternionT::Rotate).
+	//
+	template <class T> inline
+	void Rotate (QuaternionT<T> const& q, Vector3T<T> const* in, Vector3T<T>* out, size_t n, batch::Policy const& p = batch::Policy ()) {
+		VECTOR3_TIME (OpRotate, n);
+		detail::transform (detail::Affine3<T> (q.ToMatrix ()), in, out, n, p); }
+
+	template <class T> inline
+	void Rotate (QuaternionT<T> const& q, Vector3SoAT<T> const& in, Vector3SoAT<T>& out) {
+		VECTOR3_TIME (OpRotate, in.Size ());
+		detail::Affine3<T> (q.ToMatrix ()).Apply (in, out); }
+}
+
+#endif // VEC_TRANSFORM_H
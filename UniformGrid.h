@@ -0,0 +1,204 @@
+#ifndef VEC_UNIFORMGRID_H
+#define VEC_UNIFORMGRID_H
+
+#include <cstddef> // size_t
+#include <cassert>
+#include <cmath>
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include "Vector3.h"
+#include "Box3.h"
+#include "Vector3Batch.h"
+#include "Vector3Reduce.h"
+#include "KdTree.h"
+
+// ************************************************************************************
+// UniformGridT class - Uniform grid of cubic cells over Vector3T points.
+//
+// The points are counting-sorted by cell (compressed rows): the points of
+// cell c are points[start[c]] to points[start[c+1]-1], contiguous and in
+// cell order, so a query reads a few short runs. Best for roughly uniform
+// point sets with queries of radius near the cell size; the KdTreeT adapts
+// to clustered data. The cell size is grown when the grid would exceed
+// MaxCells. The grid spans the points with finite coordinates; infinite
+// and NaN points go to border cells. Queries return indices into the array
+// the grid was built from.
+//
+// ************************************************************************************
+//
+namespace Vec
+{
+	namespace detail
+	{
+		// Grows cell from cellSize by doubling until a grid over b has at
+		// most maxCells cells, and sets the cells per axis. The count is
+		// formed in double from max/cell - min/cell, so it neither wraps nor
+		// overflows on a wide box, and the casts come after the test. b must
+		// be finite and non-empty.
+		//
+		template <class T> inline
+		T grid_dims (Box3T<T> const& b, T cellSize, size_t maxCells, size_t dims[3]) {
+			T cell = cellSize;
+			double w[3];
+			for (;; cell *= T(2)) {
+				double c = 1;
+				for (int a = 0; a < 3; ++a) {
+					w[a] = std::floor (double (axis (b.max, a) / cell) - double (axis (b.min, a) / cell));
+					c *= w[a] + 1; }
+				if (c <= double (maxCells)) break; }
+			for (int a = 0; a < 3; ++a) dims[a] = size_t (w[a]) + 1;
+			return cell; }
+
+		template <class T> inline
+		bool finite (Box3T<T> const& b) {
+			return std::isfinite (b.min.x) && std::isfinite (b.min.y) && std::isfinite (b.min.z)
+				&& std::isfinite (b.max.x) && std::isfinite (b.max.y) && std::isfinite (b.max.z)
+				&& b.min.x <= b.max.x && b.min.y <= b.max.y && b.min.z <= b.max.z; }
+
+		// Bounds of the points with finite coordinates; the zero box when
+		// there are none.
+		//
+		template <class T> inline
+		Box3T<T> finite_bounds (Vector3T<T> const* v, size_t n, batch::Policy const& p) {
+			Box3T<T> b = n ? Vec::Bounds (v, n, p) : Box3T<T>::Empty ();
+			if (finite (b)) return b;
+			b = Box3T<T>::Empty ();
+			for (size_t i = 0; i < n; ++i)
+				if (std::isfinite (v[i].x) && std::isfinite (v[i].y) && std::isfinite (v[i].z)) b.Extend (v[i]);
+			return finite (b) ? b : Box3T<T> (Vector3T<T> (T(0)), Vector3T<T> (T(0))); }
+	}
+
+	template <class T>
+	class UniformGridT
+	{
+	public:
+		// Upper bound on the number of cells.
+		//
+		static const size_t MaxCells = size_t(1) << 24;
+
+		// Constructors.
+		//
+		UniformGridT () : cell(T(1)), inv(T(1)) {dims[0] = dims[1] = dims[2] = 0;}
+		UniformGridT (Vector3T<T> const* v, size_t n, T cellSize, batch::Policy const& p = batch::Policy ()) {Build (v, n, cellSize, p);}
+
+		// Builds the grid; the cell indices are computed under the policy.
+		//
+		void Build (Vector3T<T> const* v, size_t n, T cellSize, batch::Policy const& p = batch::Policy ()) {
+			assert (cellSize > T(0));
+			bounds = detail::finite_bounds (v, n, p);
+			cell = detail::grid_dims (bounds, cellSize, MaxCells, dims);
+			inv = T(1) / cell;
+			std::vector<size_t> id (n);
+			batch::For (n, p, [&] (size_t b, size_t e) {
+				for (size_t i = b; i < e; ++i) id[i] = CellOf (v[i]); });
+			start.assign (dims[0]*dims[1]*dims[2] + 1, 0);
+			for (size_t i = 0; i < n; ++i) ++start[id[i] + 1];
+			for (size_t c = 1; c < start.size (); ++c) start[c] += start[c - 1];
+			std::vector<size_t> fill (start.begin (), start.end () - 1);
+			points.resize (n); index.resize (n);
+			for (size_t i = 0; i < n; ++i) {
+				size_t j = fill[id[i]]++;
+				points[j] = v[i]; index[j] = i; } }
+
+		size_t Size () const {return points.size ();}
+		T CellSize () const {return cell;}
+
+		// The k nearest points to q, closest first, as KdTreeT::KNearest. Cells
+		// are visited in growing shells around the cell of q until no unvisited
+		// cell can hold anything closer.
+		//
+		size_t KNearest (Vector3T<T> const& q, size_t k, size_t* idx, T* dist) const {
+			if (k == 0 || points.empty ()) return 0;
+			detail::Nearest<T> best (idx, dist, k);
+			long c[3], lo[3], hi[3];
+			for (int a = 0; a < 3; ++a) c[a] = Clamp (detail::axis (q, a), a);
+			for (long r = 0;; ++r) {
+				bool whole = true;
+				for (int a = 0; a < 3; ++a) {
+					lo[a] = std::max (c[a] - r, 0L); hi[a] = std::min (c[a] + r, long (dims[a]) - 1);
+					whole = whole && lo[a] == 0 && hi[a] == long (dims[a]) - 1; }
+				for (long z = lo[2]; z <= hi[2]; ++z)
+					for (long y = lo[1]; y <= hi[1]; ++y) {
+						// Full rows on the shell faces, the two end cells inside.
+						bool face = y == c[1] - r || y == c[1] + r || z == c[2] - r || z == c[2] + r;
+						if (face) Scan (q, Index (lo[0], y, z), Index (hi[0], y, z), best);
+						else {
+							if (c[0] - r >= 0) Scan (q, Index (c[0] - r, y, z), Index (c[0] - r, y, z), best);
+							if (r > 0 && c[0] + r < long (dims[0])) Scan (q, Index (c[0] + r, y, z), Index (c[0] + r, y, z), best); } }
+				if (whole) break;
+				if (best.count == k) {
+					// Distance from q to the nearest face of the visited block
+					// that has cells beyond it.
+					T g = std::numeric_limits<T>::max ();
+					for (int a = 0; a < 3; ++a) {
+						T qa = detail::axis (q, a), o = detail::axis (bounds.min, a);
+						if (lo[a] > 0) g = std::min (g, qa - (o + T(lo[a]) * cell));
+						if (hi[a] < long (dims[a]) - 1) g = std::min (g, o + T(hi[a] + 1) * cell - qa); }
+					if (g > T(0) && g*g >= best.Worst ()) break; } }
+			return best.count; }
+
+		// Appends the indices of all points within distance r of q.
+		//
+		void Radius (Vector3T<T> const& q, T r, std::vector<size_t>& out) const {
+			Box3T<T> box (q - Vector3T<T> (r), q + Vector3T<T> (r));
+			T const r2 = r*r;
+			Visit (box, [&] (size_t i) {if (Vec::DistanceSq (q, points[i]) <= r2) out.push_back (index[i]);}); }
+
+		// Appends the indices of all points inside a box.
+		//
+		void InBox (Box3T<T> const& box, std::vector<size_t>& out) const {
+			Visit (box, [&] (size_t i) {if (box.Contains (points[i])) out.push_back (index[i]);}); }
+
+		// Batched k-nearest queries, laid out as KdTreeT::KNearest.
+		//
+		void KNearest (Vector3T<T> const* q, size_t m, size_t k, size_t* idx, T* dist, size_t* found = 0, batch::Policy const& p = batch::Policy ()) const {
+			batch::For (m, p, [this, q, k, idx, dist, found] (size_t b, size_t e) {
+				for (size_t j = b; j < e; ++j) {
+					size_t c = KNearest (q[j], k, idx + j*k, dist + j*k);
+					if (found) found[j] = c; } }); }
+
+	private:
+		long Clamp (T x, int a) const {
+			T f = (x - detail::axis (bounds.min, a)) * inv;
+			if (!(f > T(0))) return 0;
+			long d = long (dims[a]) - 1;
+			return f >= T(d) ? d : long (f); }
+
+		// Offers the points of cells b to e (inclusive) to best.
+		//
+		void Scan (Vector3T<T> const& q, size_t b, size_t e, detail::Nearest<T>& best) const {
+			for (size_t i = start[b]; i < start[e + 1]; ++i) best.Insert (index[i], Vec::DistanceSq (q, points[i])); }
+
+		size_t CellOf (Vector3T<T> const& p) const {return Index (Clamp (p.x, 0), Clamp (p.y, 1), Clamp (p.z, 2));}
+		size_t Index (long x, long y, long z) const {return (size_t (z) * dims[1] + size_t (y)) * dims[0] + size_t (x);}
+
+		// Calls fn with the position of every point in the cells overlapping box.
+		//
+		template <class F>
+		void Visit (Box3T<T> const& box, F const& fn) const {
+			if (points.empty () || !box.Overlaps (bounds)) return;
+			long x0 = Clamp (box.min.x, 0), x1 = Clamp (box.max.x, 0);
+			long y0 = Clamp (box.min.y, 1), y1 = Clamp (box.max.y, 1);
+			long z0 = Clamp (box.min.z, 2), z1 = Clamp (box.max.z, 2);
+			for (long z = z0; z <= z1; ++z)
+				for (long y = y0; y <= y1; ++y) {
+					// A row of cells is one contiguous run of points.
+					size_t b = start[Index (x0, y, z)], e = start[Index (x1, y, z) + 1];
+					for (size_t i = b; i < e; ++i) fn (i); } }
+
+		Box3T<T> bounds;
+		T cell, inv;
+		size_t dims[3];
+		std::vector<size_t> start;        // first point of each cell, plus the end
+		std::vector<Vector3T<T> > points; // cell order
+		std::vector<size_t> index;        // original index of each point
+	};
+
+	// The FLOAT_TYPE grid.
+	//
+	typedef UniformGridT<Scalar> UniformGrid;
+}
+
+#endif // VEC_UNIFORMGRID_H
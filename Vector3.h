@@ -9,6 +9,18 @@
 	#include <cmath> //
 #endif
 
+#include <type_traits> // layout checks
+#include <cstring> // memcpy for bit casts
+#include <cstdint>
+#include <limits>
+
+// SSE reciprocal square root estimates for the fast normalization functions.
+//
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#define VECTOR3_HAS_SSE2
+	#include <emmintrin.h>
+#endif
+
 #ifndef FLOAT_TYPE
 	#define FLOAT_TYPE_DEFINED
 	#define FLOAT_TYPE double
@@ -19,16 +31,40 @@
 	#define FLOAT_EPSILON 1.0E-6
 #endif
 
-struct Vector3;
+// Instrumentation hooks (see Vector3Instrument.h); they expand to nothing
+// unless VECTOR3_INSTRUMENT is defined.
+//
+#ifdef VECTOR3_INSTRUMENT
+	#include "Vector3Instrument.h"
+	#define VECTOR3_COUNT_NORMALIZE(op, m2, v) Vec::instrument::CountNormalize (Vec::instrument::op, m2, (v).x, (v).y, (v).z)
+	#define VECTOR3_TIME(op, n) Vec::instrument::Timer vector3_timer (Vec::instrument::op, n)
+#else
+	#define VECTOR3_COUNT_NORMALIZE(op, m2, v)
+	#define VECTOR3_TIME(op, n)
+#endif
+
+// Dot and Cross are constexpr unless VECTOR3_USE_FMA routes them through
+// std::fma, which is not.
+//
+#ifdef VECTOR3_USE_FMA
+	#define VECTOR3_FMA_CONSTEXPR
+#else
+	#define VECTOR3_FMA_CONSTEXPR constexpr
+#endif
 
 // ************************************************************************************
 // Vec namespace - External and helper functions for Vector3.
-// 
+//
 //
 // ************************************************************************************
 //
 namespace Vec
 {
+	// Default scalar type of Vector3 components. Unlike FLOAT_TYPE this
+	// survives the end of the header, so companion headers can use it.
+	//
+	typedef FLOAT_TYPE Scalar;
+
 	// Epsilon value for floating point equality testing.
 	//
 	const FLOAT_TYPE Epsilon = (FLOAT_TYPE) FLOAT_EPSILON;
@@ -39,111 +75,230 @@ namespace Vec
 	//
 	struct Point2D {int x, y; Point2D(){} Point2D(int x, int y):x(x),y(y){}};
 
+	static_assert (sizeof (Point2D) == 2 * sizeof (int), "Point2D layout");
+
+	// Reciprocal square root estimate refined by Steps Newton-Raphson iterations.
+	//
+	template <int Steps, class T> T rsqrt (T x);
+
+	// Vector of three components of type T. Vector3 is the FLOAT_TYPE
+	// instance; other precisions convert to it explicitly.
+	//
+	template <class T> struct Vector3T;
+
 	// Called from class members.
 	//
-	Point2D to_point2d (Vector3 const& v);
-	bool is_equal (Vector3 const& l, Vector3 const& r);
+	template <class T> Point2D to_point2d (Vector3T<T> const& v);
+	template <class T> bool is_equal (Vector3T<T> const& l, Vector3T<T> const& r);
 
 	// Magnitude squared for more efficient lenth comparisons.
 	//
-	FLOAT_TYPE MagSq (Vector3 const& v);
+	template <class T> constexpr T MagSq (Vector3T<T> const& v);
 
 	// Magnitude of a vector.
 	//
-	FLOAT_TYPE Mag (Vector3 const& v);
+	template <class T> T Mag (Vector3T<T> const& v);
 
 	// Distance squared for two Vector3 objects.
 	//
-	FLOAT_TYPE DistanceSq (Vector3 const& l, Vector3 const& r);
+	template <class T> constexpr T DistanceSq (Vector3T<T> const& l, Vector3T<T> const& r);
 
 	// Distance between two Vector3 objects.
 	//
-	FLOAT_TYPE Distance (Vector3 const& l, Vector3 const& r);
+	template <class T> T Distance (Vector3T<T> const& l, Vector3T<T> const& r);
 
 	// The dot product of two vectors.
 	//
-	FLOAT_TYPE Dot (Vector3 const& l, Vector3 const& r);
+	template <class T> VECTOR3_FMA_CONSTEXPR T Dot (Vector3T<T> const& l, Vector3T<T> const& r);
 
 	// The cross product of two vectors.
 	//
-	Vector3 Cross (Vector3 const& l, Vector3 const& r);
+	template <class T> VECTOR3_FMA_CONSTEXPR Vector3T<T> Cross (Vector3T<T> const& l, Vector3T<T> const& r);
 
-	// The zero vector.
+	// The zero vector (of FLOAT_TYPE unless requested otherwise).
 	//
-	Vector3 Zero ();
+	template <class T = Scalar> constexpr Vector3T<T> Zero ();
 
 	// Returns a normalized vector.
 	//
-	Vector3 Unit (Vector3 const& v);
+	template <class T> Vector3T<T> Unit (Vector3T<T> const& v);
 
 	// The unsigned area of the parallelogram formed by
 	// two vectors. This is really the magnitude of the
 	// cross product.
 	//
-	FLOAT_TYPE Area (Vector3 const& l, Vector3 const& r);
+	template <class T> T Area (Vector3T<T> const& l, Vector3T<T> const& r);
+
+	// Fused multiply-add variants. FmaDot rounds once per component
+	// instead of twice, FmaCross computes each a*b - c*d to within 2 ulp
+	// even when the products nearly cancel (nearly-parallel inputs), and
+	// Axpy computes y += a*x. They are only fast on FMA hardware
+	// (FP_FAST_FMA); define VECTOR3_USE_FMA to route Dot, Cross and the
+	// dot operator through them.
+	//
+	template <class T> T FmaDot (Vector3T<T> const& l, Vector3T<T> const& r);
+	template <class T> Vector3T<T> FmaCross (Vector3T<T> const& l, Vector3T<T> const& r);
+	template <class T> Vector3T<T>& Axpy (typename Vector3T<T>::Scalar a, Vector3T<T> const& x, Vector3T<T>& y);
+
+	// Returns an approximately normalized vector, built on a reciprocal
+	// square root estimate refined by Steps Newton-Raphson iterations.
+	// Maximum relative error of the result (and of NormalizeFast's length):
+	//
+	//   Steps  SSE estimate                portable estimate
+	//   0      3.7e-4                      3.5e-2
+	//   1      3.1e-7                      1.8e-3
+	//   2      2.2e-7 float, 4e-14 double  4.7e-6
+	//
+	// The SSE estimate works in float, so the squared length must stay
+	// within the float range (about 1e-38 to 3e38).
+	//
+	template <int Steps, class T> Vector3T<T> UnitFast (Vector3T<T> const& v);
+	template <class T> Vector3T<T> UnitFast (Vector3T<T> const& v);
+
+	// Returns a normalized vector, or fallback for vectors that cannot be
+	// normalized (see Vector3T::NormalizeSafe).
+	//
+	template <class T> Vector3T<T> UnitOr (Vector3T<T> const& v, Vector3T<T> const& fallback);
+
+	// Tolerant comparisons, component by component and without branches.
+	// NearlyEqual accepts |l - r| <= max(absTol, relTol * max(|l|, |r|)),
+	// so absTol covers values near zero and relTol scales with magnitude.
+	// UlpEqual accepts components at most maxUlps representable values
+	// apart (+0 and -0 are equal). NaN compares unequal in both.
+	//
+	template <class T> bool NearlyEqual (Vector3T<T> const& l, Vector3T<T> const& r, T absTol, T relTol);
+	template <class T> bool UlpEqual (Vector3T<T> const& l, Vector3T<T> const& r, uint64_t maxUlps);
+
+	// Square root usable in constant expressions, so tables of directions
+	// and samples can be computed at compile time. Matches std::sqrt for
+	// float and, where long double is wider than double, for all but rare
+	// double inputs (which are one ulp off); slower, so use it only there.
+	// ConstLength and ConstUnit are the constexpr Length and Unit.
+	//
+	template <class T> constexpr T ConstSqrt (T x);
+	template <class T> constexpr T ConstLength (Vector3T<T> const& v);
+	template <class T> constexpr Vector3T<T> ConstUnit (Vector3T<T> const& v);
 }
 
 
 // ************************************************************************************
-// Vector3 structure
+// Vector3T structure
 //
 //
 // ************************************************************************************
 //
-struct Vector3
+namespace Vec
 {
-	FLOAT_TYPE x, y, z;
-
-	// Constructors.
-	//
-	Vector3 (){}
-	explicit Vector3 (FLOAT_TYPE f) : x(f), y(f), z(f) {}
-	Vector3 (Vector3 const& v) : x(v.x), y(v.y), z(v.z) {}
-	Vector3 (FLOAT_TYPE x, FLOAT_TYPE y, FLOAT_TYPE z) : x(x), y(y), z(z) {}
-	~Vector3 (){}
-
-	// Operators.
-	//
-	// Non-constant.
-	//
-	Vector3& operator= (Vector3 const& v) {x=v.x; y=v.y; z=v.z; return *this;}
-	Vector3& operator*= (FLOAT_TYPE s) {x=s*x, y=s*y; z=s*z; return *this;}
-	Vector3& operator/= (FLOAT_TYPE s) {FLOAT_TYPE t=Vec::One/s; x*=t; y*=t; z*=t; return *this;}
-	Vector3& operator+= (Vector3 const& v) {x+=v.x; y+=v.y; z+=v.z; return *this;}
-	Vector3& operator-= (Vector3 const& v) {x-=v.x; y-=v.y; z-=v.z; return *this;}
-
-	// Constant.
-	//
-	Vector3 operator* (FLOAT_TYPE s) const {Vector3 w(*this); w*=s; return w;}
-	Vector3 operator/ (FLOAT_TYPE s) const {Vector3 w(*this); w/=s; return w;}
-	Vector3 operator+ (Vector3 const& v) const {Vector3 w(*this); w+=v; return w;}
-	Vector3 operator- (Vector3 const& v) const {Vector3 w(*this); w-=v; return w;}
-	Vector3 operator- () const {Vector3 w(*this); w*=-1.0; return w;}
-	FLOAT_TYPE operator* (Vector3 const& v) const {return x*v.x + y*v.y + z*v.z;} // dot
-	bool operator== (Vector3 const& v) const {return this==&v || Vec::is_equal (*this, v);}
-	bool operator!= (Vector3 const& v) const {return !(*this == v);}
-	operator Vec::Point2D () const {return Vec::to_point2d (*this);}
-	
-	// Vector length (magnitude).
+	template <class T>
+	struct Vector3T
+	{
+		typedef T Scalar;
+
+		T x, y, z;
+
+		// Constructors. Copy, assignment and destruction are left to the
+		// compiler so Vector3T stays trivial and can be moved with memcpy.
+		//
+		Vector3T () = default;
+		constexpr explicit Vector3T (T f) : x(f), y(f), z(f) {}
+		constexpr Vector3T (T x, T y, T z) : x(x), y(y), z(z) {}
+
+		// Explicit conversion between precisions.
+		//
+		template <class U>
+		constexpr explicit Vector3T (Vector3T<U> const& v) : x(T(v.x)), y(T(v.y)), z(T(v.z)) {}
+
+		// Operators.
+		//
+		// Non-constant.
+		//
+		Vector3T& operator*= (T s) {x=s*x, y=s*y; z=s*z; return *this;}
+		Vector3T& operator/= (T s) {T t=T(1)/s; x*=t; y*=t; z*=t; return *this;}
+		Vector3T& operator+= (Vector3T const& v) {x+=v.x; y+=v.y; z+=v.z; return *this;}
+		Vector3T& operator-= (Vector3T const& v) {x-=v.x; y-=v.y; z-=v.z; return *this;}
+
+		// Constant, and usable in constant expressions.
+		//
+		constexpr Vector3T operator* (T s) const {return Vector3T (s*x, s*y, s*z);}
+		constexpr Vector3T operator/ (T s) const {return *this * (T(1)/s);}
+		constexpr Vector3T operator+ (Vector3T const& v) const {return Vector3T (x+v.x, y+v.y, z+v.z);}
+		constexpr Vector3T operator- (Vector3T const& v) const {return Vector3T (x-v.x, y-v.y, z-v.z);}
+		constexpr Vector3T operator- () const {return Vector3T (-x, -y, -z);}
+#ifdef VECTOR3_USE_FMA
+		T operator* (Vector3T const& v) const {return Vec::FmaDot (*this, v);} // dot
+#else
+		constexpr T operator* (Vector3T const& v) const {return x*v.x + y*v.y + z*v.z;} // dot
+#endif
+		bool operator== (Vector3T const& v) const {return Vec::is_equal (*this, v);}
+		bool operator!= (Vector3T const& v) const {return !(*this == v);}
+		operator Vec::Point2D () const {return Vec::to_point2d (*this);}
+
+		// Vector length (magnitude).
+		//
+		constexpr T LengthSq () const {return x*x + y*y + z*z;}
+		T Length () const {return std::sqrt (LengthSq ());}
+
+		// Converts this vector into a unit vector (returns the previous length).
+		//
+		T Normalize () {
+			T m2 = x*x+y*y+z*z; T m = std::sqrt (m2); T mi = T(1)/m; x*=mi; y*=mi; z*=mi;
+			VECTOR3_COUNT_NORMALIZE (OpNormalize, m2, *this);
+			return m; }
+
+		// Approximate Normalize without sqrt or divide (see Vec::UnitFast for
+		// the error of each number of Newton steps).
+		//
+		template <int Steps>
+		T NormalizeFast () {
+			T m2 = x*x+y*y+z*z; T mi = Vec::rsqrt<Steps> (m2); x*=mi; y*=mi; z*=mi;
+			VECTOR3_COUNT_NORMALIZE (OpNormalizeFast, m2, *this);
+			return m2*mi; }
+		T NormalizeFast () {return NormalizeFast<1> ();}
+
+		// Converts this vector into a unit vector, or into fallback when its
+		// squared length is zero, subnormal, infinite or NaN. Branchless, so
+		// loops over it still vectorize. Returns the previous length.
+		//
+		T NormalizeSafe (Vector3T const& fallback) {
+			T m2 = x*x+y*y+z*z; T m = std::sqrt (m2);
+			bool ok = (m2 >= std::numeric_limits<T>::min ()) & (m2 <= std::numeric_limits<T>::max ());
+			T mi = T(1)/(ok ? m : T(1));
+			x = ok ? x*mi : fallback.x; y = ok ? y*mi : fallback.y; z = ok ? z*mi : fallback.z;
+			VECTOR3_COUNT_NORMALIZE (OpNormalizeSafe, m2, *this);
+			return m; }
+
+		// Converts this vector to the zero vector.
+		//
+		void Zero () {x=y=z=T(0);}
+	};
+
+	// External operators for Vector3T. The scalar is not deduced so
+	// 2.0*v works for every precision.
 	//
-	FLOAT_TYPE LengthSq () const {return x*x + y*y + z*z;}
-	FLOAT_TYPE Length () const {return sqrt (LengthSq ());}
+	template <class T> inline constexpr
+	Vector3T<T> operator* (typename Vector3T<T>::Scalar f, Vector3T<T> const& v) {
+		return Vector3T<T> (f*v.x, f*v.y, f*v.z);
+	}
 
-	// Converts this vector into a unit vector (returns the previous length).
+	// Common precisions.
 	//
-	FLOAT_TYPE Normalize () {FLOAT_TYPE m = sqrt (x*x+y*y+z*z); FLOAT_TYPE mi = Vec::One/m; x*=mi; y*=mi; z*=mi; return m;}
+	typedef Vector3T<float> Vector3f;
+	typedef Vector3T<double> Vector3d;
+}
 
-	// Converts this vector to the zero vector.
-	//
-	void Zero () {x=y=z=0.0;}
-};
+// The default vector type.
+//
+typedef Vec::Vector3T<FLOAT_TYPE> Vector3;
 
-// External operators for Vector3.
+// Vector3T must stay a trivial, standard-layout triple of scalars so arrays
+// of it can be relocated, serialized and viewed in place.
 //
-inline
-Vector3 operator* (FLOAT_TYPE f, Vector3 const& v) {
-	return Vector3 (f*v.x, f*v.y, f*v.z);
-}
+static_assert (std::is_trivially_copyable<Vector3>::value, "Vector3 must be trivially copyable");
+static_assert (std::is_trivial<Vector3>::value, "Vector3 must be trivial");
+static_assert (std::is_standard_layout<Vector3>::value, "Vector3 must be standard-layout");
+static_assert (sizeof (Vector3) == 3 * sizeof (FLOAT_TYPE), "Vector3 must not be padded");
+static_assert (std::is_trivial<Vec::Vector3f>::value && sizeof (Vec::Vector3f) == 3 * sizeof (float), "Vector3f layout");
+static_assert (std::is_trivial<Vec::Vector3d>::value && sizeof (Vec::Vector3d) == 3 * sizeof (double), "Vector3d layout");
 
 
 // ************************************************************************************
@@ -156,15 +311,32 @@ namespace Vec
 {
 	// External vector functions.
 	//
-	inline FLOAT_TYPE MagSq (Vector3 const& v) {return v.LengthSq ();}
-	inline FLOAT_TYPE Mag (Vector3 const& v) {return v.Length ();}
-	inline FLOAT_TYPE DistanceSq (Vector3 const& l, Vector3 const& r) {return MagSq (l-r);}
-	inline FLOAT_TYPE Distance (Vector3 const& l, Vector3 const& r) {return Mag (l-r);}
-	inline FLOAT_TYPE Dot (Vector3 const& l, Vector3 const& r) {return l * r;}
-	inline Vector3 Cross (Vector3 const& l, Vector3 const& r) {return Vector3 (l.y*r.z - l.z*r.y, l.z*r.x - l.x*r.z, l.x*r.y - l.y*r.x);}
-	inline Vector3 Zero () {return Vector3 (0.0);}
-	inline Vector3 Unit (Vector3 const& v) {Vector3 r(v); r.Normalize (); return r;}
-	inline FLOAT_TYPE Area (Vector3 const& l, Vector3 const& r) {return Mag (Cross (l, r));}
+	template <class T> inline constexpr T MagSq (Vector3T<T> const& v) {return v.LengthSq ();}
+	template <class T> inline T Mag (Vector3T<T> const& v) {return v.Length ();}
+	template <class T> inline constexpr T DistanceSq (Vector3T<T> const& l, Vector3T<T> const& r) {return MagSq (l-r);}
+	template <class T> inline T Distance (Vector3T<T> const& l, Vector3T<T> const& r) {return Mag (l-r);}
+	template <class T> inline VECTOR3_FMA_CONSTEXPR T Dot (Vector3T<T> const& l, Vector3T<T> const& r) {return l * r;}
+#ifdef VECTOR3_USE_FMA
+	template <class T> inline Vector3T<T> Cross (Vector3T<T> const& l, Vector3T<T> const& r) {return FmaCross (l, r);}
+#else
+	template <class T> inline constexpr Vector3T<T> Cross (Vector3T<T> const& l, Vector3T<T> const& r) {return Vector3T<T> (l.y*r.z - l.z*r.y, l.z*r.x - l.x*r.z, l.x*r.y - l.y*r.x);}
+#endif
+	template <class T> inline constexpr Vector3T<T> Zero () {return Vector3T<T> (T(0));}
+	template <class T> inline Vector3T<T> Unit (Vector3T<T> const& v) {Vector3T<T> r(v); r.Normalize (); return r;}
+	template <class T> inline T Area (Vector3T<T> const& l, Vector3T<T> const& r) {return Mag (Cross (l, r));}
+
+	// a*b - c*d with one rounding error (Kahan's algorithm).
+	//
+	template <class T> inline T diff_of_products (T a, T b, T c, T d) {
+		T w = c*d; T e = std::fma (-c, d, w); T f = std::fma (a, b, -w); return f + e; }
+
+	// Fused multiply-add vector functions.
+	//
+	template <class T> inline T FmaDot (Vector3T<T> const& l, Vector3T<T> const& r) {return std::fma (l.x, r.x, std::fma (l.y, r.y, l.z*r.z));}
+	template <class T> inline Vector3T<T> FmaCross (Vector3T<T> const& l, Vector3T<T> const& r) {
+		return Vector3T<T> (diff_of_products (l.y, r.z, l.z, r.y), diff_of_products (l.z, r.x, l.x, r.z), diff_of_products (l.x, r.y, l.y, r.x)); }
+	template <class T> inline Vector3T<T>& Axpy (typename Vector3T<T>::Scalar a, Vector3T<T> const& x, Vector3T<T>& y) {
+		y.x = std::fma (a, x.x, y.x); y.y = std::fma (a, x.y, y.y); y.z = std::fma (a, x.z, y.z); return y; }
 }
 
 
@@ -178,14 +350,125 @@ namespace Vec
 {
 	// Helper functions.
 	//
-	inline int round (FLOAT_TYPE f) {
-		return int ((f < 0.0) ? (f - 0.5) : (f + 0.5)); }
+	// Rounds half away from zero without branching on the sign: the
+	// fraction is doubled and truncated to -1, 0 or 1. Values beyond the int
+	// range saturate and NaN gives 0.
+	//
+	template <class T> inline int round (T f) {
+		T t = std::trunc (f);
+		T r = t + std::trunc (T(2) * (f - t));
+		return f >= T(2147483647.5) ? std::numeric_limits<int>::max () :
+		      (f <= T(-2147483648.5) ? std::numeric_limits<int>::min () : (f == f ? int (r) : 0)); }
+
+	// Absolute comparison against Epsilon. The three tests combine with &
+	// rather than && so the comparison compiles without branches.
+	//
+	template <class T> inline bool is_equal (Vector3T<T> const& l, Vector3T<T> const& r) {
+		T const e = T(Vec::Epsilon);
+		return (std::fabs (l.x-r.x) < e) & (std::fabs (l.y-r.y) < e) & (std::fabs (l.z-r.z) < e); }
+
+	template <class T> inline bool nearly_equal (T l, T r, T absTol, T relTol) {
+		T m = std::fabs (l) > std::fabs (r) ? std::fabs (l) : std::fabs (r);
+		T tol = relTol * m > absTol ? relTol * m : absTol;
+		return std::fabs (l - r) <= tol; }
+
+	// Maps the bits of a float or double to an integer that is ordered like
+	// the value: sign-magnitude becomes two's complement, so adjacent values
+	// differ by one and +0 and -0 both map to 0.
+	//
+	inline int64_t ulp_key (float f) {
+		int32_t i; std::memcpy (&i, &f, sizeof i);
+		int32_t m = i >> 31;
+		return int64_t (((i & 0x7fffffff) ^ m) - m); }
 
-	inline bool is_equal (Vector3 const& l, Vector3 const& r) {
-		return ((abs(l.x-r.x) < Vec::Epsilon) && (abs(l.y-r.y) < Vec::Epsilon) && (abs(l.z-r.z) < Vec::Epsilon)); }
+	inline int64_t ulp_key (double d) {
+		int64_t i; std::memcpy (&i, &d, sizeof i);
+		int64_t m = i >> 63;
+		return ((i & 0x7fffffffffffffffll) ^ m) - m; }
 
-	inline Point2D Vec::to_point2d (Vector3 const& v) {
+	template <class T> inline bool ulp_equal (T l, T r, uint64_t maxUlps) {
+		int64_t a = ulp_key (l), b = ulp_key (r);
+		uint64_t d = a > b ? uint64_t (a) - uint64_t (b) : uint64_t (b) - uint64_t (a);
+		return (d <= maxUlps) & (l == l) & (r == r); }
+
+	template <class T> inline bool NearlyEqual (Vector3T<T> const& l, Vector3T<T> const& r, T absTol, T relTol) {
+		return nearly_equal (l.x, r.x, absTol, relTol) & nearly_equal (l.y, r.y, absTol, relTol) & nearly_equal (l.z, r.z, absTol, relTol); }
+
+	template <class T> inline bool UlpEqual (Vector3T<T> const& l, Vector3T<T> const& r, uint64_t maxUlps) {
+		return ulp_equal (l.x, r.x, maxUlps) & ulp_equal (l.y, r.y, maxUlps) & ulp_equal (l.z, r.z, maxUlps); }
+
+	template <class T> inline Point2D to_point2d (Vector3T<T> const& v) {
 		return Vec::Point2D (Vec::round (v.x), Vec::round (v.y)); }
+
+	// Initial 1/sqrt(x) estimates: rsqrtss where available, otherwise the
+	// classic integer shift with tuned magic constants.
+	//
+	inline float rsqrt_estimate (float x) {
+#ifdef VECTOR3_HAS_SSE2
+		return _mm_cvtss_f32 (_mm_rsqrt_ss (_mm_set_ss (x)));
+#else
+		uint32_t i; std::memcpy (&i, &x, sizeof i);
+		i = 0x5f375a86u - (i >> 1);
+		float y; std::memcpy (&y, &i, sizeof y); return y;
+#endif
+	}
+
+	inline double rsqrt_estimate (double x) {
+#ifdef VECTOR3_HAS_SSE2
+		return _mm_cvtss_f32 (_mm_rsqrt_ss (_mm_set_ss (float (x))));
+#else
+		uint64_t i; std::memcpy (&i, &x, sizeof i);
+		i = 0x5fe6eb50c7b537a9ull - (i >> 1);
+		double y; std::memcpy (&y, &i, sizeof y); return y;
+#endif
+	}
+
+	// One Newton-Raphson step for 1/sqrt(x) from the estimate y.
+	//
+	template <class T> inline T rsqrt_step (T x, T y) {
+		return y * (T(1.5) - T(0.5)*x*y*y); }
+
+	template <int Steps, class T> inline T rsqrt (T x) {
+		T y = T(rsqrt_estimate (x));
+		for (int i = 0; i < Steps; ++i) y = rsqrt_step (x, y);
+		return y; }
+
+	// Fast normalization.
+	//
+	template <int Steps, class T> inline Vector3T<T> UnitFast (Vector3T<T> const& v) {Vector3T<T> r(v); r.template NormalizeFast<Steps> (); return r;}
+	template <class T> inline Vector3T<T> UnitFast (Vector3T<T> const& v) {return UnitFast<1> (v);}
+
+	// Zero-length-safe normalization.
+	//
+	template <class T> inline Vector3T<T> UnitOr (Vector3T<T> const& v, Vector3T<T> const& fallback) {Vector3T<T> r(v); r.NormalizeSafe (fallback); return r;}
+
+	// Constant expression square root: Newton-Raphson from 1 once x has
+	// been scaled into [1/4, 4) by exact powers of two, stopping when an
+	// iteration no longer changes the result.
+	//
+	template <class T> constexpr T const_sqrt_newton (T x, T r, T next, int steps) {
+		return steps == 0 || r == next ? next : const_sqrt_newton (x, next, T(0.5) * (next + x/next), steps - 1); }
+
+	template <class T> constexpr T const_sqrt_scaled (T x) {
+		return x >= T(18446744073709551616.0) ? T(4294967296.0) * const_sqrt_scaled (x * T(1.0 / 18446744073709551616.0)) :
+		       x < T(1.0 / 18446744073709551616.0) ? T(1.0 / 4294967296.0) * const_sqrt_scaled (x * T(18446744073709551616.0)) :
+		       x >= T(4) ? T(2) * const_sqrt_scaled (x * T(0.25)) :
+		       x < T(0.25) ? T(0.5) * const_sqrt_scaled (x * T(4)) :
+		       const_sqrt_newton (x, T(1), T(0.5) * (T(1) + x), 16); }
+
+	// Newton-Raphson runs one precision up, so the final rounding to T is
+	// almost always the correctly rounded root.
+	//
+	template <class T> struct const_sqrt_wide {typedef long double type;};
+	template <> struct const_sqrt_wide<float> {typedef double type;};
+
+	template <class T> inline constexpr T ConstSqrt (T x) {
+		return x != x || x < T(0) ? std::numeric_limits<T>::quiet_NaN () :
+		       x == T(0) || x > std::numeric_limits<T>::max () ? x :
+		       T(const_sqrt_scaled (typename const_sqrt_wide<T>::type (x))); }
+
+	template <class T> inline constexpr T ConstLength (Vector3T<T> const& v) {return ConstSqrt (v.LengthSq ());}
+	template <class T> inline constexpr Vector3T<T> ConstUnit (Vector3T<T> const& v) {return v * (T(1) / ConstLength (v));}
 }
 
 #ifdef FLOAT_TYPE_DEFINED
@@ -195,7 +478,7 @@ namespace Vec
 
 #ifdef FLOAT_EPSILON_DEFINED
 	#undef FLOAT_EPSILON
-	#undef FLOAT_EPSILON_DIFINED
+	#undef FLOAT_EPSILON_DEFINED
 #endif
 
-#endif // VECTOR3_H
\ No newline at end of file
+#endif // VECTOR3_H
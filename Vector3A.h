@@ -0,0 +1,202 @@
+#ifndef VECTOR3A_H
+#define VECTOR3A_H
+
+#include <cmath>
+#include <type_traits>
+
+#include "Vector3.h"
+
+#if defined(__AVX__)
+	#include <immintrin.h>
+#endif
+
+// ************************************************************************************
+// Vector3AT structure - Vector3T padded to four lanes and aligned to them.
+//
+// x, y, z and a zero pad lane w fill exactly one SSE register (float) or one
+// AVX register (double), so every load is aligned and the arithmetic
+// operators are single SSE/AVX instructions. Reductions (dot, length) ignore
+// the pad lane. Without SSE2, and for double without AVX (two SSE2
+// registers), the same interface falls back to four-lane loops.
+//
+// ************************************************************************************
+//
+namespace Vec
+{
+	namespace detail
+	{
+		// Four-lane arithmetic on aligned arrays. mul scales by {s, s, s, 0}
+		// so the pad lane stays zero for infinite or NaN s.
+		//
+		template <class T>
+		struct Lanes
+		{
+			static void add (T* r, T const* a, T const* b) {for (int k = 0; k < 4; ++k) r[k] = a[k] + b[k];}
+			static void sub (T* r, T const* a, T const* b) {for (int k = 0; k < 4; ++k) r[k] = a[k] - b[k];}
+			static void mul (T* r, T const* a, T s) {for (int k = 0; k < 3; ++k) r[k] = a[k] * s; r[3] = T(0);}
+			static T dot3 (T const* a, T const* b) {return a[0]*b[0] + a[1]*b[1] + a[2]*b[2];}
+			static void cross (T* r, T const* a, T const* b) {
+				T x = a[1]*b[2] - a[2]*b[1], y = a[2]*b[0] - a[0]*b[2], z = a[0]*b[1] - a[1]*b[0];
+				r[0] = x; r[1] = y; r[2] = z; r[3] = T(0); }
+		};
+
+#ifdef VECTOR3_HAS_SSE2
+		template <>
+		struct Lanes<float>
+		{
+			static void add (float* r, float const* a, float const* b) {_mm_store_ps (r, _mm_add_ps (_mm_load_ps (a), _mm_load_ps (b)));}
+			static void sub (float* r, float const* a, float const* b) {_mm_store_ps (r, _mm_sub_ps (_mm_load_ps (a), _mm_load_ps (b)));}
+			static void mul (float* r, float const* a, float s) {_mm_store_ps (r, _mm_mul_ps (_mm_load_ps (a), _mm_set_ps (0.0f, s, s, s)));}
+			static float dot3 (float const* a, float const* b) {
+				__m128 m = _mm_and_ps (_mm_mul_ps (_mm_load_ps (a), _mm_load_ps (b)), _mm_castsi128_ps (_mm_set_epi32 (0, -1, -1, -1)));
+				__m128 t = _mm_add_ps (m, _mm_movehl_ps (m, m));
+				return _mm_cvtss_f32 (_mm_add_ss (t, _mm_shuffle_ps (t, t, _MM_SHUFFLE (1, 1, 1, 1)))); }
+			static void cross (float* r, float const* a, float const* b) {
+				__m128 l = _mm_load_ps (a), k = _mm_load_ps (b);
+				__m128 l1 = _mm_shuffle_ps (l, l, _MM_SHUFFLE (3, 0, 2, 1)), k2 = _mm_shuffle_ps (k, k, _MM_SHUFFLE (3, 1, 0, 2));
+				__m128 l2 = _mm_shuffle_ps (l, l, _MM_SHUFFLE (3, 1, 0, 2)), k1 = _mm_shuffle_ps (k, k, _MM_SHUFFLE (3, 0, 2, 1));
+				_mm_store_ps (r, _mm_sub_ps (_mm_mul_ps (l1, k2), _mm_mul_ps (l2, k1))); }
+		};
+
+		template <>
+		struct Lanes<double>
+		{
+	#ifdef __AVX__
+			static void add (double* r, double const* a, double const* b) {_mm256_store_pd (r, _mm256_add_pd (_mm256_load_pd (a), _mm256_load_pd (b)));}
+			static void sub (double* r, double const* a, double const* b) {_mm256_store_pd (r, _mm256_sub_pd (_mm256_load_pd (a), _mm256_load_pd (b)));}
+			static void mul (double* r, double const* a, double s) {_mm256_store_pd (r, _mm256_mul_pd (_mm256_load_pd (a), _mm256_set_pd (0.0, s, s, s)));}
+			static double dot3 (double const* a, double const* b) {
+				__m256d m = _mm256_mul_pd (_mm256_load_pd (a), _mm256_load_pd (b));
+				__m128d lo = _mm256_castpd256_pd128 (m), hi = _mm256_extractf128_pd (m, 1);
+				return _mm_cvtsd_f64 (_mm_add_sd (_mm_add_sd (lo, _mm_unpackhi_pd (lo, lo)), hi)); }
+	#else
+			static void add (double* r, double const* a, double const* b) {
+				_mm_store_pd (r, _mm_add_pd (_mm_load_pd (a), _mm_load_pd (b)));
+				_mm_store_pd (r + 2, _mm_add_pd (_mm_load_pd (a + 2), _mm_load_pd (b + 2))); }
+			static void sub (double* r, double const* a, double const* b) {
+				_mm_store_pd (r, _mm_sub_pd (_mm_load_pd (a), _mm_load_pd (b)));
+				_mm_store_pd (r + 2, _mm_sub_pd (_mm_load_pd (a + 2), _mm_load_pd (b + 2))); }
+			static void mul (double* r, double const* a, double s) {
+				_mm_store_pd (r, _mm_mul_pd (_mm_load_pd (a), _mm_set1_pd (s)));
+				_mm_store_pd (r + 2, _mm_mul_pd (_mm_load_pd (a + 2), _mm_set_pd (0.0, s))); }
+			static double dot3 (double const* a, double const* b) {
+				__m128d lo = _mm_mul_pd (_mm_load_pd (a), _mm_load_pd (b));
+				__m128d hi = _mm_mul_sd (_mm_load_sd (a + 2), _mm_load_sd (b + 2));
+				return _mm_cvtsd_f64 (_mm_add_sd (_mm_add_sd (lo, _mm_unpackhi_pd (lo, lo)), hi)); }
+	#endif
+	#ifdef __AVX2__
+			static void cross (double* r, double const* a, double const* b) {
+				__m256d l = _mm256_load_pd (a), k = _mm256_load_pd (b);
+				__m256d l1 = _mm256_permute4x64_pd (l, _MM_SHUFFLE (3, 0, 2, 1)), k2 = _mm256_permute4x64_pd (k, _MM_SHUFFLE (3, 1, 0, 2));
+				__m256d l2 = _mm256_permute4x64_pd (l, _MM_SHUFFLE (3, 1, 0, 2)), k1 = _mm256_permute4x64_pd (k, _MM_SHUFFLE (3, 0, 2, 1));
+				_mm256_store_pd (r, _mm256_sub_pd (_mm256_mul_pd (l1, k2), _mm256_mul_pd (l2, k1))); }
+	#else
+			static void cross (double* r, double const* a, double const* b) {
+				double x = a[1]*b[2] - a[2]*b[1], y = a[2]*b[0] - a[0]*b[2], z = a[0]*b[1] - a[1]*b[0];
+				r[0] = x; r[1] = y; r[2] = z; r[3] = 0.0; }
+	#endif
+		};
+#endif
+	}
+
+	template <class T>
+	struct alignas (4 * sizeof (T)) Vector3AT
+	{
+		typedef T Scalar;
+		typedef detail::Lanes<T> L;
+
+		T x, y, z, w; // w is padding, zeroed by every constructor but the default
+
+		// Constructors. The default one leaves all four lanes uninitialized,
+		// as Vector3T does, so the type stays trivial; reductions ignore w.
+		//
+		Vector3AT () = default;
+		constexpr explicit Vector3AT (T f) : x(f), y(f), z(f), w(T(0)) {}
+		constexpr Vector3AT (T x, T y, T z) : x(x), y(y), z(z), w(T(0)) {}
+
+		// Conversion from and to Vector3T.
+		//
+		constexpr explicit Vector3AT (Vector3T<T> const& v) : x(v.x), y(v.y), z(v.z), w(T(0)) {}
+		constexpr Vector3T<T> ToVector3 () const {return Vector3T<T> (x, y, z);}
+		constexpr explicit operator Vector3T<T> () const {return ToVector3 ();}
+
+		// Operators.
+		//
+		// Non-constant.
+		//
+		Vector3AT& operator*= (T s) {L::mul (&x, &x, s); return *this;}
+		Vector3AT& operator/= (T s) {L::mul (&x, &x, T(1)/s); return *this;}
+		Vector3AT& operator+= (Vector3AT const& v) {L::add (&x, &x, &v.x); return *this;}
+		Vector3AT& operator-= (Vector3AT const& v) {L::sub (&x, &x, &v.x); return *this;}
+
+		// Constant.
+		//
+		Vector3AT operator* (T s) const {Vector3AT r; L::mul (&r.x, &x, s); return r;}
+		Vector3AT operator/ (T s) const {Vector3AT r; L::mul (&r.x, &x, T(1)/s); return r;}
+		Vector3AT operator+ (Vector3AT const& v) const {Vector3AT r; L::add (&r.x, &x, &v.x); return r;}
+		Vector3AT operator- (Vector3AT const& v) const {Vector3AT r; L::sub (&r.x, &x, &v.x); return r;}
+		Vector3AT operator- () const {Vector3AT r; L::mul (&r.x, &x, T(-1)); return r;}
+		T operator* (Vector3AT const& v) const {return L::dot3 (&x, &v.x);} // dot
+		bool operator== (Vector3AT const& v) const {return Vec::is_equal (ToVector3 (), v.ToVector3 ());}
+		bool operator!= (Vector3AT const& v) const {return !(*this == v);}
+		operator Vec::Point2D () const {return Vec::to_point2d (ToVector3 ());}
+
+		// Vector length (magnitude).
+		//
+		T LengthSq () const {return L::dot3 (&x, &x);}
+		T Length () const {return std::sqrt (LengthSq ());}
+
+		// Converts this vector into a unit vector (returns the previous length).
+		//
+		T Normalize () {T m = Length (); L::mul (&x, &x, T(1)/m); return m;}
+
+		// Approximate and zero-length-safe Normalize, as Vector3T's.
+		//
+		template <int Steps>
+		T NormalizeFast () {Vector3T<T> v = ToVector3 (); T m = v.template NormalizeFast<Steps> (); *this = Vector3AT (v); return m;}
+		T NormalizeFast () {return NormalizeFast<1> ();}
+		T NormalizeSafe (Vector3AT const& fallback) {Vector3T<T> v = ToVector3 (); T m = v.NormalizeSafe (fallback.ToVector3 ()); *this = Vector3AT (v); return m;}
+
+		// Converts this vector to the zero vector.
+		//
+		void Zero () {x=y=z=w=T(0);}
+	};
+
+	// External operators for Vector3AT.
+	//
+	template <class T> inline
+	Vector3AT<T> operator* (typename Vector3AT<T>::Scalar f, Vector3AT<T> const& v) {return v * f;}
+
+	// The FLOAT_TYPE and fixed precision aligned vectors.
+	//
+	typedef Vector3AT<Scalar> Vector3A;
+	typedef Vector3AT<float> Vector3Af;
+	typedef Vector3AT<double> Vector3Ad;
+
+	static_assert (sizeof (Vector3Af) == 16 && alignof (Vector3Af) == 16, "Vector3Af must fill one SSE register");
+	static_assert (sizeof (Vector3Ad) == 32 && alignof (Vector3Ad) == 32, "Vector3Ad must fill one AVX register");
+	static_assert (std::is_trivial<Vector3A>::value && std::is_standard_layout<Vector3A>::value, "Vector3A must be trivial");
+
+	// External vector functions, mirroring the Vector3T ones.
+	//
+	template <class T> inline T MagSq (Vector3AT<T> const& v) {return v.LengthSq ();}
+	template <class T> inline T Mag (Vector3AT<T> const& v) {return v.Length ();}
+	template <class T> inline T DistanceSq (Vector3AT<T> const& l, Vector3AT<T> const& r) {return MagSq (l-r);}
+	template <class T> inline T Distance (Vector3AT<T> const& l, Vector3AT<T> const& r) {return Mag (l-r);}
+	template <class T> inline T Dot (Vector3AT<T> const& l, Vector3AT<T> const& r) {return l * r;}
+	template <class T> inline Vector3AT<T> Cross (Vector3AT<T> const& l, Vector3AT<T> const& r) {Vector3AT<T> c; detail::Lanes<T>::cross (&c.x, &l.x, &r.x); return c;}
+	template <class T = Scalar> inline Vector3AT<T> ZeroA () {return Vector3AT<T> (T(0));}
+	template <class T> inline Vector3AT<T> Unit (Vector3AT<T> const& v) {Vector3AT<T> r(v); r.Normalize (); return r;}
+	template <int Steps, class T> inline Vector3AT<T> UnitFast (Vector3AT<T> const& v) {Vector3AT<T> r(v); r.template NormalizeFast<Steps> (); return r;}
+	template <class T> inline Vector3AT<T> UnitFast (Vector3AT<T> const& v) {return UnitFast<1> (v);}
+	template <class T> inline Vector3AT<T> UnitOr (Vector3AT<T> const& v, Vector3AT<T> const& fallback) {Vector3AT<T> r(v); r.NormalizeSafe (fallback); return r;}
+	template <class T> inline T FmaDot (Vector3AT<T> const& l, Vector3AT<T> const& r) {return FmaDot (l.ToVector3 (), r.ToVector3 ());}
+	template <class T> inline Vector3AT<T> FmaCross (Vector3AT<T> const& l, Vector3AT<T> const& r) {return Vector3AT<T> (FmaCross (l.ToVector3 (), r.ToVector3 ()));}
+	template <class T> inline Vector3AT<T>& Axpy (typename Vector3AT<T>::Scalar a, Vector3AT<T> const& x, Vector3AT<T>& y) {
+		y.x = std::fma (a, x.x, y.x); y.y = std::fma (a, x.y, y.y); y.z = std::fma (a, x.z, y.z); return y; }
+	template <class T> inline T Area (Vector3AT<T> const& l, Vector3AT<T> const& r) {return Mag (Cross (l, r));}
+	template <class T> inline bool is_equal (Vector3AT<T> const& l, Vector3AT<T> const& r) {return is_equal (l.ToVector3 (), r.ToVector3 ());}
+	template <class T> inline Point2D to_point2d (Vector3AT<T> const& v) {return to_point2d (v.ToVector3 ());}
+}
+
+#endif // VECTOR3A_H
@@ -0,0 +1,252 @@
+#ifndef VECTOR3_BATCH_H
+#define VECTOR3_BATCH_H
+
+#include <cstddef> // size_t
+#include <atomic>
+
+#include "Vector3.h"
+#include "ThreadPool.h"
+
+#ifdef VECTOR3_USE_STD_EXECUTION
+	#include <algorithm>
+	#include <execution>
+	#include <numeric>
+#endif
+
+// ************************************************************************************
+// Vec::batch namespace - Vec functions over arrays of Vector3T, optionally parallel.
+//
+// Every function takes a Policy: no pool (the default) runs serially on the
+// calling thread, a ThreadPool splits the array into chunks of Policy::chunk
+// elements. With VECTOR3_USE_STD_EXECUTION defined, Policy::ParUnseq() hands
+// the chunks to std::for_each with std::execution::par_unseq instead (C++17;
+// libstdc++ needs TBB linked for it).
+//
+// ************************************************************************************
+//
+namespace Vec
+{
+namespace batch
+{
+	// Chunk size that amortizes scheduling while staying cache resident.
+	//
+	const size_t DefaultChunk = 16384;
+
+	// How a batch function is executed.
+	//
+	struct Policy
+	{
+		ThreadPool* pool;
+		size_t chunk;
+		bool parUnseq;
+
+		Policy () : pool(0), chunk(DefaultChunk), parUnseq(false) {}
+		Policy (ThreadPool& pool, size_t chunk = DefaultChunk) : pool(&pool), chunk(chunk), parUnseq(false) {}
+
+		// Serial execution on the calling thread.
+		//
+		static Policy Serial () {return Policy ();}
+
+		// The process-wide pool.
+		//
+		static Policy Parallel (size_t chunk = DefaultChunk) {return Policy (DefaultPool (), chunk);}
+
+#ifdef VECTOR3_USE_STD_EXECUTION
+		// Standard parallel algorithms.
+		//
+		static Policy ParUnseq (size_t chunk = DefaultChunk) {Policy p; p.chunk = chunk; p.parUnseq = true; return p;}
+#endif
+	};
+
+	// Calls fn(begin, end) over chunks covering [0, n) as the policy says.
+	//
+	template <class F> inline
+	void For (size_t n, Policy const& p, F const& fn) {
+		size_t const chunk = p.chunk ? p.chunk : DefaultChunk;
+#ifdef VECTOR3_USE_STD_EXECUTION
+		if (p.parUnseq && n > chunk) {
+			std::vector<size_t> chunks ((n + chunk - 1) / chunk);
+			std::iota (chunks.begin (), chunks.end (), size_t(0));
+			std::for_each (std::execution::par_unseq, chunks.begin (), chunks.end (), [&] (size_t c) {
+				size_t b = c * chunk; fn (b, (n - b < chunk) ? n : b + chunk); });
+			return; }
+#endif
+		// By reference, so the std::function never allocates.
+		if (p.pool) p.pool->ParallelFor (n, chunk, std::cref (fn));
+		else if (n) fn (0, n); }
+
+	// Normalizes every vector in place (Vector3T::Normalize); previous
+	// lengths go to lengths when it is not null.
+	//
+	template <class T> inline
+	void Normalize (Vector3T<T>* v, size_t n, T* lengths = 0, Policy const& p = Policy ()) {
+		VECTOR3_TIME (OpBatchNormalize, n);
+		For (n, p, [=] (size_t b, size_t e) {
+			if (lengths) for (size_t i = b; i < e; ++i) lengths[i] = v[i].Normalize ();
+			else for (size_t i = b; i < e; ++i) v[i].Normalize (); }); }
+
+	template <class T> inline
+	void Normalize (Vector3T<T>* v, size_t n, Policy const& p) {Normalize (v, n, (T*) 0, p);}
+
+	// Approximate normalization (Vector3T::NormalizeFast with one Newton step).
+	//
+	template <class T> inline
+	void NormalizeFast (Vector3T<T>* v, size_t n, Policy const& p = Policy ()) {
+		VECTOR3_TIME (OpBatchNormalizeFast, n);
+		For (n, p, [=] (size_t b, size_t e) {
+			for (size_t i = b; i < e; ++i) v[i].NormalizeFast (); }); }
+
+	// Zero-length-safe normalization (Vector3T::NormalizeSafe).
+	//
+	template <class T> inline
+	void NormalizeSafe (Vector3T<T>* v, size_t n, Vector3T<T> const& fallback, Policy const& p = Policy ()) {
+		VECTOR3_TIME (OpBatchNormalizeSafe, n);
+		For (n, p, [=] (size_t b, size_t e) {
+			for (size_t i = b; i < e; ++i) v[i].NormalizeSafe (fallback); }); }
+
+	// Normalized copies (Vec::Unit).
+	//
+	template <class T> inline
+	void Unit (Vector3T<T> const* v, size_t n, Vector3T<T>* out, Policy const& p = Policy ()) {
+		VECTOR3_TIME (OpBatchUnit, n);
+		For (n, p, [=] (size_t b, size_t e) {
+			for (size_t i = b; i < e; ++i) out[i] = Vec::Unit (v[i]); }); }
+
+	namespace detail
+	{
+		// Rounds the x and y of n vectors as Vec::round.
+		//
+		template <class T> inline
+		void to_point2d (Vector3T<T> const* v, Point2D* out, size_t n) {
+			for (size_t i = 0; i < n; ++i) out[i] = Vec::to_point2d (v[i]); }
+
+#ifdef VECTOR3_HAS_SSE2
+		// Four lanes of Vec::round: truncate, add the truncated doubled
+		// fraction, then patch the saturated and NaN lanes.
+		//
+		inline __m128i round_ps (__m128 f) {
+			__m128 t = _mm_cvtepi32_ps (_mm_cvttps_epi32 (f));
+			__m128 r = _mm_add_ps (t, _mm_cvtepi32_ps (_mm_cvttps_epi32 (_mm_mul_ps (_mm_set1_ps (2.0f), _mm_sub_ps (f, t)))));
+			__m128i i = _mm_cvttps_epi32 (r);
+			__m128i hi = _mm_castps_si128 (_mm_cmpge_ps (f, _mm_set1_ps (2147483648.0f)));
+			__m128i lo = _mm_castps_si128 (_mm_cmple_ps (f, _mm_set1_ps (-2147483648.0f)));
+			__m128i ok = _mm_castps_si128 (_mm_cmpord_ps (f, f));
+			i = _mm_or_si128 (_mm_andnot_si128 (_mm_or_si128 (hi, lo), i), _mm_or_si128 (_mm_and_si128 (hi, _mm_set1_epi32 (0x7fffffff)), _mm_and_si128 (lo, _mm_set1_epi32 (int (0x80000000u)))));
+			return _mm_and_si128 (i, ok); }
+
+		inline __m128i round_pd (__m128d f) {
+			__m128d t = _mm_cvtepi32_pd (_mm_cvttpd_epi32 (f));
+			__m128d r = _mm_add_pd (t, _mm_cvtepi32_pd (_mm_cvttpd_epi32 (_mm_mul_pd (_mm_set1_pd (2.0), _mm_sub_pd (f, t)))));
+			__m128i i = _mm_cvttpd_epi32 (r);
+			__m128i hi = _mm_castpd_si128 (_mm_cmpge_pd (f, _mm_set1_pd (2147483647.5)));
+			__m128i lo = _mm_castpd_si128 (_mm_cmple_pd (f, _mm_set1_pd (-2147483648.5)));
+			__m128i ok = _mm_castpd_si128 (_mm_cmpord_pd (f, f));
+			// The masks are 64 bits per lane; pack them to the low 32 bit lanes.
+			hi = _mm_shuffle_epi32 (hi, _MM_SHUFFLE (3, 1, 2, 0));
+			lo = _mm_shuffle_epi32 (lo, _MM_SHUFFLE (3, 1, 2, 0));
+			ok = _mm_shuffle_epi32 (ok, _MM_SHUFFLE (3, 1, 2, 0));
+			i = _mm_or_si128 (_mm_andnot_si128 (_mm_or_si128 (hi, lo), i), _mm_or_si128 (_mm_and_si128 (hi, _mm_set1_epi32 (0x7fffffff)), _mm_and_si128 (lo, _mm_set1_epi32 (int (0x80000000u)))));
+			return _mm_and_si128 (i, ok); }
+
+		// Four vectors per step: three loads give x0 y0 z0 x1 | y1 z1 x2 y2 |
+		// z2 x3 y3 z3, shuffled into x0 y0 x1 y1 and x2 y2 x3 y3.
+		//
+		inline void to_point2d (Vector3T<float> const* v, Point2D* out, size_t n) {
+			float const* p = &v[0].x;
+			size_t i = 0;
+			for (; i + 4 <= n; i += 4, p += 12) {
+				__m128 a = _mm_loadu_ps (p), b = _mm_loadu_ps (p + 4), c = _mm_loadu_ps (p + 8);
+				__m128 x1y1 = _mm_shuffle_ps (a, b, _MM_SHUFFLE (0, 0, 3, 3));
+				__m128 xy01 = _mm_shuffle_ps (a, x1y1, _MM_SHUFFLE (2, 0, 1, 0));
+				__m128 xy23 = _mm_shuffle_ps (b, c, _MM_SHUFFLE (2, 1, 3, 2));
+				_mm_storeu_si128 (reinterpret_cast<__m128i*> (out + i), round_ps (xy01));
+				_mm_storeu_si128 (reinterpret_cast<__m128i*> (out + i + 2), round_ps (xy23)); }
+			for (; i < n; ++i) out[i] = Vec::to_point2d (v[i]); }
+
+		inline void to_point2d (Vector3T<double> const* v, Point2D* out, size_t n) {
+			for (size_t i = 0; i < n; ++i)
+				_mm_storel_epi64 (reinterpret_cast<__m128i*> (out + i), round_pd (_mm_loadu_pd (&v[i].x))); }
+#endif
+	}
+
+	// Projects every vector to a Point2D (Vec::to_point2d), with SSE2
+	// rounding for float and double.
+	//
+	template <class T> inline
+	void ToPoint2D (Vector3T<T> const* v, size_t n, Point2D* out, Policy const& p = Policy ()) {
+		VECTOR3_TIME (OpBatchToPoint2D, n);
+		For (n, p, [=] (size_t b, size_t e) {detail::to_point2d (v + b, out + b, e - b);}); }
+
+	// Distance and distance squared of every vector to a point.
+	//
+	template <class T> inline
+	void Distance (Vector3T<T> const* v, size_t n, Vector3T<T> const& point, T* out, Policy const& p = Policy ()) {
+		VECTOR3_TIME (OpBatchDistance, n);
+		For (n, p, [=] (size_t b, size_t e) {
+			for (size_t i = b; i < e; ++i) out[i] = Vec::Distance (v[i], point); }); }
+
+	template <class T> inline
+	void DistanceSq (Vector3T<T> const* v, size_t n, Vector3T<T> const& point, T* out, Policy const& p = Policy ()) {
+		VECTOR3_TIME (OpBatchDistanceSq, n);
+		For (n, p, [=] (size_t b, size_t e) {
+			for (size_t i = b; i < e; ++i) out[i] = Vec::DistanceSq (v[i], point); }); }
+
+	// Dot products of corresponding vectors.
+	//
+	template <class T> inline
+	void Dot (Vector3T<T> const* l, Vector3T<T> const* r, size_t n, T* out, Policy const& p = Policy ()) {
+		VECTOR3_TIME (OpBatchDot, n);
+		For (n, p, [=] (size_t b, size_t e) {
+			for (size_t i = b; i < e; ++i) out[i] = l[i] * r[i]; }); }
+
+	// Affine update v = v*scale + offset.
+	//
+	template <class T> inline
+	void Affine (Vector3T<T>* v, size_t n, T scale, Vector3T<T> const& offset, Policy const& p = Policy ()) {
+		VECTOR3_TIME (OpBatchAffine, n);
+		For (n, p, [=] (size_t b, size_t e) {
+			for (size_t i = b; i < e; ++i) {v[i] *= scale; v[i] += offset;} }); }
+
+	// y += a*x for corresponding vectors (Vec::Axpy).
+	//
+	template <class T> inline
+	void Axpy (T a, Vector3T<T> const* x, Vector3T<T>* y, size_t n, Policy const& p = Policy ()) {
+		VECTOR3_TIME (OpBatchAxpy, n);
+		For (n, p, [=] (size_t b, size_t e) {
+			for (size_t i = b; i < e; ++i) Vec::Axpy (a, x[i], y[i]); }); }
+
+	// Comparison masks: mask[i] is 1 where l[i] and r[i] compare equal
+	// (Vec::NearlyEqual, Vec::UlpEqual) and 0 elsewhere.
+	//
+	template <class T> inline
+	void NearlyEqual (Vector3T<T> const* l, Vector3T<T> const* r, size_t n, T absTol, T relTol, uint8_t* mask, Policy const& p = Policy ()) {
+		VECTOR3_TIME (OpBatchNearlyEqual, n);
+		For (n, p, [=] (size_t b, size_t e) {
+			for (size_t i = b; i < e; ++i) mask[i] = uint8_t (Vec::NearlyEqual (l[i], r[i], absTol, relTol)); }); }
+
+	template <class T> inline
+	void UlpEqual (Vector3T<T> const* l, Vector3T<T> const* r, size_t n, uint64_t maxUlps, uint8_t* mask, Policy const& p = Policy ()) {
+		VECTOR3_TIME (OpBatchUlpEqual, n);
+		For (n, p, [=] (size_t b, size_t e) {
+			for (size_t i = b; i < e; ++i) mask[i] = uint8_t (Vec::UlpEqual (l[i], r[i], maxUlps)); }); }
+
+	// Change detection: mask[i] is 1 where cur[i] lies farther than eps
+	// from prev[i]. Returns the number of points that moved.
+	//
+	template <class T> inline
+	size_t Moved (Vector3T<T> const* prev, Vector3T<T> const* cur, size_t n, T eps, uint8_t* mask, Policy const& p = Policy ()) {
+		VECTOR3_TIME (OpBatchMoved, n);
+		T const e2 = eps * eps;
+		std::atomic<size_t> moved (0);
+		std::atomic<size_t>* m = &moved;
+		For (n, p, [=] (size_t b, size_t e) {
+			size_t c = 0;
+			for (size_t i = b; i < e; ++i) {
+				uint8_t f = uint8_t (Vec::DistanceSq (prev[i], cur[i]) > e2);
+				mask[i] = f; c += f; }
+			m->fetch_add (c, std::memory_order_relaxed); });
+		return moved.load (); }
+}
+}
+
+#endif // VECTOR3_BATCH_H
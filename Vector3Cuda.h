@@ -0,0 +1,377 @@
+#ifndef VECTOR3_CUDA_H
+#define VECTOR3_CUDA_H
+
+#ifndef __CUDACC__
+	#error "Vector3Cuda.h is CUDA source; compile it with nvcc"
+#endif
+
+#include <climits> // INT_MAX
+#include <cstddef> // size_t
+#include <new>     // bad_alloc
+#include <cuda_runtime.h>
+#include <cub/device/device_radix_sort.cuh>
+#include <cub/device/device_scan.cuh>
+
+#include "Vector3.h"
+#include "Box3.h"
+#include "Matrix4.h"
+#include "UniformGrid.h"
+
+// ************************************************************************************
+// Vec::cuda namespace - Batch Vector3T kernels on CUDA devices.
+//
+// The functions mirror Vec::batch and the reductions on device arrays.
+// They take raw device pointers and a Stream instead of a Policy, and they
+// are asynchronous: each one queues its work on the stream and returns
+// false only when the launch fails. Stream::Synchronize reports errors from
+// the kernels. Stage host data in PinnedBuffer memory so a copy on one
+// stream overlaps the kernels of another; copies from pageable memory
+// block the host.
+//
+// The CPU functions are the reference. Compiled with --fmad=false (and the
+// default -prec-div=true -prec-sqrt=true), Normalize, TransformPoints,
+// TransformDirections, Distance and Bounds give bit-identical results.
+// Sum adds in a different order, so it agrees only to rounding.
+// UniformGrid::Build produces the same layout as UniformGridT::Build.
+//
+// ************************************************************************************
+//
+namespace Vec
+{
+namespace cuda
+{
+	// A stream that does not synchronize with the legacy default stream.
+	//
+	class Stream
+	{
+	public:
+		Stream () : s(0) {if (cudaStreamCreateWithFlags (&s, cudaStreamNonBlocking) != cudaSuccess) throw std::bad_alloc ();}
+		~Stream () {cudaStreamDestroy (s);}
+
+		cudaStream_t Get () const {return s;}
+
+		// Waits for the queued work; false when any of it failed.
+		//
+		bool Synchronize () {return cudaStreamSynchronize (s) == cudaSuccess && cudaGetLastError () == cudaSuccess;}
+
+	private:
+		Stream (Stream const&);
+		Stream& operator= (Stream const&);
+
+		cudaStream_t s;
+	};
+
+	// Device memory for n objects of a trivially copyable type; throws
+	// std::bad_alloc when the device is out of memory. Resize does not keep
+	// the contents.
+	//
+	template <class T>
+	class DeviceBuffer
+	{
+	public:
+		DeviceBuffer () : data(0), size(0) {}
+		explicit DeviceBuffer (size_t n) : data(0), size(0) {Resize (n);}
+		~DeviceBuffer () {cudaFree (data);}
+
+		void Resize (size_t n) {
+			if (n == size) return;
+			cudaFree (data); data = 0; size = 0;
+			if (n && cudaMalloc (reinterpret_cast<void**> (&data), n * sizeof (T)) != cudaSuccess) throw std::bad_alloc ();
+			size = n; }
+
+		T* Data () {return data;}
+		T const* Data () const {return data;}
+		size_t Size () const {return size;}
+
+		// Asynchronous copies of n objects starting at the front.
+		//
+		bool Upload (T const* host, size_t n, Stream& s) {
+			return cudaMemcpyAsync (data, host, n * sizeof (T), cudaMemcpyHostToDevice, s.Get ()) == cudaSuccess;}
+		bool Download (T* host, size_t n, Stream& s) const {
+			return cudaMemcpyAsync (host, data, n * sizeof (T), cudaMemcpyDeviceToHost, s.Get ()) == cudaSuccess;}
+
+	private:
+		DeviceBuffer (DeviceBuffer const&);
+		DeviceBuffer& operator= (DeviceBuffer const&);
+
+		T* data;
+		size_t size;
+	};
+
+	// Page-locked host memory, the staging area for asynchronous copies.
+	//
+	template <class T>
+	class PinnedBuffer
+	{
+	public:
+		PinnedBuffer () : data(0), size(0) {}
+		explicit PinnedBuffer (size_t n) : data(0), size(0) {Resize (n);}
+		~PinnedBuffer () {cudaFreeHost (data);}
+
+		void Resize (size_t n) {
+			if (n == size) return;
+			cudaFreeHost (data); data = 0; size = 0;
+			if (n && cudaMallocHost (reinterpret_cast<void**> (&data), n * sizeof (T)) != cudaSuccess) throw std::bad_alloc ();
+			size = n; }
+
+		T* Data () {return data;}
+		T const* Data () const {return data;}
+		size_t Size () const {return size;}
+		T& operator[] (size_t i) {return data[i];}
+		T const& operator[] (size_t i) const {return data[i];}
+
+	private:
+		PinnedBuffer (PinnedBuffer const&);
+		PinnedBuffer& operator= (PinnedBuffer const&);
+
+		T* data;
+		size_t size;
+	};
+
+	namespace detail
+	{
+		// Threads per block, and the blocks of a grid-stride launch over n
+		// elements.
+		//
+		static const unsigned BlockSize = 256;
+
+		inline unsigned blocks (size_t n) {
+			size_t b = (n + BlockSize - 1) / BlockSize;
+			return unsigned (b < 4096 ? (b ? b : 1) : 4096); }
+
+		inline bool launched () {return cudaPeekAtLastError () == cudaSuccess;}
+
+		// The kernels spell out the operations of the CPU functions they
+		// mirror, in the same order.
+		//
+		template <class T> __global__
+		void normalize (Vector3T<T>* v, size_t n) {
+			for (size_t i = blockIdx.x * size_t (blockDim.x) + threadIdx.x; i < n; i += size_t (gridDim.x) * blockDim.x) {
+				T x = v[i].x, y = v[i].y, z = v[i].z;
+				T m = sqrt (x*x+y*y+z*z); T mi = T(1)/m;
+				v[i].x = x*mi; v[i].y = y*mi; v[i].z = z*mi; } }
+
+		// t is the translation for points and zero for directions, as in
+		// Vec::detail::Affine3.
+		//
+		template <class T> __global__
+		void transform (Matrix4T<T> m, Vector3T<T> t, Vector3T<T> const* in, Vector3T<T>* out, size_t n) {
+			for (size_t i = blockIdx.x * size_t (blockDim.x) + threadIdx.x; i < n; i += size_t (gridDim.x) * blockDim.x) {
+				T x = in[i].x, y = in[i].y, z = in[i].z;
+				out[i].x = m.m[0][0]*x + m.m[0][1]*y + m.m[0][2]*z + t.x;
+				out[i].y = m.m[1][0]*x + m.m[1][1]*y + m.m[1][2]*z + t.y;
+				out[i].z = m.m[2][0]*x + m.m[2][1]*y + m.m[2][2]*z + t.z; } }
+
+		template <class T> __global__
+		void distance (Vector3T<T> const* v, size_t n, Vector3T<T> p, T* out, bool squared) {
+			for (size_t i = blockIdx.x * size_t (blockDim.x) + threadIdx.x; i < n; i += size_t (gridDim.x) * blockDim.x) {
+				T x = v[i].x - p.x, y = v[i].y - p.y, z = v[i].z - p.z;
+				T d2 = x*x + y*y + z*z;
+				out[i] = squared ? d2 : sqrt (d2); } }
+
+		// Block partials of the sum (one per block) and the final sum.
+		//
+		template <class T> __global__
+		void sum (Vector3T<T> const* v, size_t n, Vector3T<T>* out) {
+			__shared__ T s[3][BlockSize];
+			T x = T(0), y = T(0), z = T(0);
+			for (size_t i = blockIdx.x * size_t (blockDim.x) + threadIdx.x; i < n; i += size_t (gridDim.x) * blockDim.x) {
+				x += v[i].x; y += v[i].y; z += v[i].z; }
+			s[0][threadIdx.x] = x; s[1][threadIdx.x] = y; s[2][threadIdx.x] = z;
+			__syncthreads ();
+			for (unsigned k = BlockSize / 2; k > 0; k /= 2) {
+				if (threadIdx.x < k)
+					for (int a = 0; a < 3; ++a) s[a][threadIdx.x] += s[a][threadIdx.x + k];
+				__syncthreads (); }
+			if (threadIdx.x == 0) {out[blockIdx.x].x = s[0][0]; out[blockIdx.x].y = s[1][0]; out[blockIdx.x].z = s[2][0];} }
+
+		// Block partials of the bounds, as Box3T::Extend.
+		//
+		template <class T> __global__
+		void bounds (Vector3T<T> const* v, size_t n, Box3T<T>* out, Box3T<T> empty) {
+			__shared__ Vector3T<T> lo[BlockSize], hi[BlockSize];
+			Vector3T<T> l = empty.min, h = empty.max;
+			for (size_t i = blockIdx.x * size_t (blockDim.x) + threadIdx.x; i < n; i += size_t (gridDim.x) * blockDim.x) {
+				Vector3T<T> p = v[i];
+				l.x = p.x < l.x ? p.x : l.x; h.x = p.x > h.x ? p.x : h.x;
+				l.y = p.y < l.y ? p.y : l.y; h.y = p.y > h.y ? p.y : h.y;
+				l.z = p.z < l.z ? p.z : l.z; h.z = p.z > h.z ? p.z : h.z; }
+			lo[threadIdx.x] = l; hi[threadIdx.x] = h;
+			__syncthreads ();
+			for (unsigned k = BlockSize / 2; k > 0; k /= 2) {
+				if (threadIdx.x < k) {
+					Vector3T<T>& a = lo[threadIdx.x]; Vector3T<T> const& b = lo[threadIdx.x + k];
+					a.x = b.x < a.x ? b.x : a.x; a.y = b.y < a.y ? b.y : a.y; a.z = b.z < a.z ? b.z : a.z;
+					Vector3T<T>& c = hi[threadIdx.x]; Vector3T<T> const& d = hi[threadIdx.x + k];
+					c.x = d.x > c.x ? d.x : c.x; c.y = d.y > c.y ? d.y : c.y; c.z = d.z > c.z ? d.z : c.z; }
+				__syncthreads (); }
+			if (threadIdx.x == 0) {out[blockIdx.x].min = lo[0]; out[blockIdx.x].max = hi[0];} }
+
+		// UniformGridT::CellOf for every point, with the original indices.
+		//
+		template <class T> __device__
+		unsigned clamp_cell (T x, T o, T inv, unsigned d) {
+			T f = (x - o) * inv;
+			if (!(f > T(0))) return 0;
+			return f >= T(d - 1) ? d - 1 : unsigned (f); }
+
+		template <class T> __global__
+		void cells (Vector3T<T> const* v, size_t n, Vector3T<T> o, T inv, unsigned dx, unsigned dy, unsigned dz, unsigned* id, size_t* index) {
+			for (size_t i = blockIdx.x * size_t (blockDim.x) + threadIdx.x; i < n; i += size_t (gridDim.x) * blockDim.x) {
+				unsigned x = clamp_cell (v[i].x, o.x, inv, dx), y = clamp_cell (v[i].y, o.y, inv, dy), z = clamp_cell (v[i].z, o.z, inv, dz);
+				id[i] = (z * dy + y) * dx + x;
+				index[i] = i; } }
+
+		// Counts the points of each cell into count[cell + 1].
+		//
+		template <class C> __global__
+		void histogram (unsigned const* id, size_t n, C* count) {
+			for (size_t i = blockIdx.x * size_t (blockDim.x) + threadIdx.x; i < n; i += size_t (gridDim.x) * blockDim.x)
+				atomicAdd (count + id[i] + 1, C(1)); }
+
+		template <class T> __global__
+		void gather (Vector3T<T> const* v, size_t const* index, size_t n, Vector3T<T>* out) {
+			for (size_t i = blockIdx.x * size_t (blockDim.x) + threadIdx.x; i < n; i += size_t (gridDim.x) * blockDim.x)
+				out[i] = v[index[i]]; }
+	}
+
+	// Unit vectors in place (batch::Normalize).
+	//
+	template <class T> inline
+	bool Normalize (Vector3T<T>* v, size_t n, Stream& s) {
+		if (n) detail::normalize<<<detail::blocks (n), detail::BlockSize, 0, s.Get ()>>> (v, n);
+		return detail::launched (); }
+
+	// Transformed points and directions (Vec::TransformPoints and
+	// Vec::TransformDirections); in and out may be the same array.
+	//
+	template <class T> inline
+	bool TransformPoints (Matrix4T<T> const& m, Vector3T<T> const* in, Vector3T<T>* out, size_t n, Stream& s) {
+		if (n) detail::transform<<<detail::blocks (n), detail::BlockSize, 0, s.Get ()>>> (m, Vector3T<T> (m.m[0][3], m.m[1][3], m.m[2][3]), in, out, n);
+		return detail::launched (); }
+
+	template <class T> inline
+	bool TransformDirections (Matrix4T<T> const& m, Vector3T<T> const* in, Vector3T<T>* out, size_t n, Stream& s) {
+		if (n) detail::transform<<<detail::blocks (n), detail::BlockSize, 0, s.Get ()>>> (m, Vector3T<T> (T(0)), in, out, n);
+		return detail::launched (); }
+
+	// Distance and distance squared of every vector to a point
+	// (batch::Distance, batch::DistanceSq).
+	//
+	template <class T> inline
+	bool Distance (Vector3T<T> const* v, size_t n, Vector3T<T> const& point, T* out, Stream& s) {
+		if (n) detail::distance<<<detail::blocks (n), detail::BlockSize, 0, s.Get ()>>> (v, n, point, out, false);
+		return detail::launched (); }
+
+	template <class T> inline
+	bool DistanceSq (Vector3T<T> const* v, size_t n, Vector3T<T> const& point, T* out, Stream& s) {
+		if (n) detail::distance<<<detail::blocks (n), detail::BlockSize, 0, s.Get ()>>> (v, n, point, out, true);
+		return detail::launched (); }
+
+	// Reductions into device memory: result[0] receives the value, scratch
+	// holds the block partials between the two passes (and is resized as
+	// needed). Download result into pinned memory to read it.
+	//
+	template <class T> inline
+	bool Sum (Vector3T<T> const* v, size_t n, Vector3T<T>* result, DeviceBuffer<Vector3T<T> >& scratch, Stream& s) {
+		unsigned b = detail::blocks (n);
+		scratch.Resize (b);
+		detail::sum<<<b, detail::BlockSize, 0, s.Get ()>>> (v, n, scratch.Data ());
+		detail::sum<<<1, detail::BlockSize, 0, s.Get ()>>> (scratch.Data (), b, result);
+		return detail::launched (); }
+
+	template <class T> inline
+	bool Bounds (Vector3T<T> const* v, size_t n, Box3T<T>* result, DeviceBuffer<Box3T<T> >& scratch, Stream& s) {
+		unsigned b = detail::blocks (n);
+		scratch.Resize (b);
+		Box3T<T> const empty = Box3T<T>::Empty ();
+		if (!n) {
+			// One block over no points writes Empty (); its corners would
+			// reduce to the full box.
+			detail::bounds<<<1, detail::BlockSize, 0, s.Get ()>>> (v, 0, result, empty);
+			return detail::launched (); }
+		detail::bounds<<<b, detail::BlockSize, 0, s.Get ()>>> (v, n, scratch.Data (), empty);
+		// The partial boxes are reduced as a list of their corners.
+		detail::bounds<<<1, detail::BlockSize, 0, s.Get ()>>> (reinterpret_cast<Vector3T<T> const*> (scratch.Data ()), 2 * size_t (b), result, empty);
+		return detail::launched (); }
+
+
+	// ************************************************************************************
+	// UniformGridT class - Device build of the UniformGridT cell layout.
+	//
+	// The cell size and dimensions are chosen as on the CPU, from bounds the
+	// caller provides (from cuda::Bounds, or known in advance). Points are
+	// stable-sorted by cell with a radix sort, so Start, Points and Index
+	// hold exactly what UniformGridT::Build computes for the same input:
+	// Start has one entry per cell plus the end, x varies fastest, and the
+	// points of a cell keep their input order.
+	//
+	// ************************************************************************************
+	//
+	template <class T>
+	class UniformGridT
+	{
+	public:
+		UniformGridT () : cell(T(1)), size(0) {dims[0] = dims[1] = dims[2] = 0;}
+
+		// Queues the build of the grid of v (n device points within bounds).
+		// With no points box is ignored and the grid is one empty cell at the
+		// origin, as on the CPU. Returns false when box is not finite or n
+		// exceeds INT_MAX.
+		//
+		bool Build (Vector3T<T> const* v, size_t n, Box3T<T> const& box, T cellSize, Stream& s) {
+			// CUB takes int counts, and a non-finite box has no grid.
+			if (n > size_t (INT_MAX) || (n && !Vec::detail::finite (box))) return false;
+			bounds = n ? box : Box3T<T> (Vector3T<T> (T(0)), Vector3T<T> (T(0))); size = n;
+			cell = Vec::detail::grid_dims (bounds, cellSize, Vec::UniformGridT<T>::MaxCells, dims);
+			size_t const cells = dims[0] * dims[1] * dims[2];
+			unsigned bits = 1;
+			while ((size_t (1) << bits) < cells) ++bits;
+
+			id.Resize (2 * n); order.Resize (2 * n); points.Resize (n); count.Resize (cells + 1);
+			start.Resize (cells + 1);
+			if (cudaMemsetAsync (count.Data (), 0, (cells + 1) * sizeof (unsigned long long), s.Get ()) != cudaSuccess) return false;
+			if (n) {
+				detail::cells<<<detail::blocks (n), detail::BlockSize, 0, s.Get ()>>> (v, n, bounds.min, T(1) / cell,
+					unsigned (dims[0]), unsigned (dims[1]), unsigned (dims[2]), id.Data (), order.Data ());
+				detail::histogram<<<detail::blocks (n), detail::BlockSize, 0, s.Get ()>>> (id.Data (), n, count.Data ()); }
+
+			// Temporary storage of the sort and the scan.
+			size_t sortBytes = 0, scanBytes = 0;
+			cub::DeviceRadixSort::SortPairs (0, sortBytes, id.Data (), id.Data () + n, order.Data (), order.Data () + n, int (n), 0, int (bits), s.Get ());
+			cub::DeviceScan::InclusiveSum (0, scanBytes, count.Data (), start.Data (), int (cells + 1), s.Get ());
+			temp.Resize (sortBytes > scanBytes ? sortBytes : scanBytes);
+
+			if (n && cub::DeviceRadixSort::SortPairs (temp.Data (), sortBytes, id.Data (), id.Data () + n, order.Data (), order.Data () + n,
+				int (n), 0, int (bits), s.Get ()) != cudaSuccess) return false;
+			if (cub::DeviceScan::InclusiveSum (temp.Data (), scanBytes, count.Data (), start.Data (), int (cells + 1), s.Get ()) != cudaSuccess) return false;
+			if (n) detail::gather<<<detail::blocks (n), detail::BlockSize, 0, s.Get ()>>> (v, order.Data () + n, n, points.Data ());
+			return detail::launched (); }
+
+		size_t Size () const {return size;}
+		T CellSize () const {return cell;}
+		size_t Cells () const {return dims[0] * dims[1] * dims[2];}
+		size_t Dim (int a) const {return dims[a];}
+		Box3T<T> const& Bounds () const {return bounds;}
+
+		// Device arrays: the first point of each cell plus the end, the
+		// points in cell order and the original index of each.
+		//
+		unsigned long long const* Start () const {return start.Data ();}
+		Vector3T<T> const* Points () const {return points.Data ();}
+		size_t const* Index () const {return order.Data () + size;}
+
+	private:
+		Box3T<T> bounds;
+		T cell;
+		size_t dims[3], size;
+		DeviceBuffer<unsigned> id;                 // cell of each point; sorted in the upper half
+		DeviceBuffer<size_t> order;                // 0..n-1; sorted by cell in the upper half
+		DeviceBuffer<Vector3T<T> > points;
+		DeviceBuffer<unsigned long long> count, start;
+		DeviceBuffer<char> temp;
+	};
+}
+}
+
+#endif // VECTOR3_CUDA_H
@@ -0,0 +1,164 @@
+#ifndef VECTOR3_DISPATCH_H
+#define VECTOR3_DISPATCH_H
+
+#include <cstddef> // size_t
+#include <cmath>
+#include <cassert>
+
+#include "Vector3.h"
+#include "Vector3SoA.h"
+
+// ************************************************************************************
+// Vec::dispatch namespace - Runtime CPU dispatch of the batch kernels.
+//
+// Each kernel is compiled once per instruction set from the same loop, using
+// GCC/Clang target attributes, so a binary built for the x86-64 baseline
+// still runs AVX2 or AVX-512 code on machines that have it. The CPU is
+// queried on first use and the function pointers of the best level are kept
+// for the life of the process. The Generic level is the portable loop built
+// for the translation unit's own target (SSE2 on x86-64, NEON on AArch64,
+// plain scalar code elsewhere) and gives the same results as the inline
+// Vector3SoA functions. The AVX2 and AVX-512 levels also enable FMA, so the
+// compiler may fuse multiply-adds and results can differ in the last bit.
+//
+// ************************************************************************************
+//
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+	#define VECTOR3_DISPATCH_X86
+	#define VEC_TARGET_AVX2 __attribute__ ((target ("avx2,fma")))
+	#define VEC_TARGET_AVX512 __attribute__ ((target ("avx512f")))
+#endif
+
+namespace Vec
+{
+namespace dispatch
+{
+	// Instruction set levels, in increasing order.
+	//
+	enum Level {Generic, AVX2, AVX512};
+
+	// Kernel table for one scalar type. Arrays are component streams of n
+	// vectors; outputs may not alias inputs.
+	//
+	template <class T>
+	struct KernelsT
+	{
+		void (*Dot) (T const* lx, T const* ly, T const* lz, T const* rx, T const* ry, T const* rz, T* out, size_t n);
+		void (*Cross) (T const* lx, T const* ly, T const* lz, T const* rx, T const* ry, T const* rz, T* ox, T* oy, T* oz, size_t n);
+		void (*Normalize) (T* x, T* y, T* z, size_t n);
+		void (*Distance) (T const* lx, T const* ly, T const* lz, T const* rx, T const* ry, T const* rz, T* out, size_t n);
+		Level level;
+	};
+
+	// One set of kernels per level; TARGET is the function attribute that
+	// selects the instruction set.
+	//
+	#define VEC_DISPATCH_KERNELS(NS, TARGET) \
+	namespace NS \
+	{ \
+		template <class T> TARGET \
+		void Dot (T const* VEC_RESTRICT lx, T const* VEC_RESTRICT ly, T const* VEC_RESTRICT lz, T const* VEC_RESTRICT rx, T const* VEC_RESTRICT ry, T const* VEC_RESTRICT rz, T* VEC_RESTRICT out, size_t n) { \
+			for (size_t i = 0; i < n; ++i) out[i] = lx[i]*rx[i] + ly[i]*ry[i] + lz[i]*rz[i]; } \
+		template <class T> TARGET \
+		void Cross (T const* VEC_RESTRICT lx, T const* VEC_RESTRICT ly, T const* VEC_RESTRICT lz, T const* VEC_RESTRICT rx, T const* VEC_RESTRICT ry, T const* VEC_RESTRICT rz, T* VEC_RESTRICT ox, T* VEC_RESTRICT oy, T* VEC_RESTRICT oz, size_t n) { \
+			for (size_t i = 0; i < n; ++i) { \
+				ox[i] = ly[i]*rz[i] - lz[i]*ry[i]; oy[i] = lz[i]*rx[i] - lx[i]*rz[i]; oz[i] = lx[i]*ry[i] - ly[i]*rx[i]; } } \
+		template <class T> TARGET \
+		void Normalize (T* VEC_RESTRICT x, T* VEC_RESTRICT y, T* VEC_RESTRICT z, size_t n) { \
+			for (size_t i = 0; i < n; ++i) { \
+				T mi = T(1)/std::sqrt (x[i]*x[i] + y[i]*y[i] + z[i]*z[i]); x[i]*=mi; y[i]*=mi; z[i]*=mi; } } \
+		template <class T> TARGET \
+		void Distance (T const* VEC_RESTRICT lx, T const* VEC_RESTRICT ly, T const* VEC_RESTRICT lz, T const* VEC_RESTRICT rx, T const* VEC_RESTRICT ry, T const* VEC_RESTRICT rz, T* VEC_RESTRICT out, size_t n) { \
+			for (size_t i = 0; i < n; ++i) { \
+				T dx = lx[i]-rx[i], dy = ly[i]-ry[i], dz = lz[i]-rz[i]; out[i] = std::sqrt (dx*dx + dy*dy + dz*dz); } } \
+		template <class T> inline KernelsT<T> Table (Level level) { \
+			KernelsT<T> k = {&Dot<T>, &Cross<T>, &Normalize<T>, &Distance<T>, level}; return k; } \
+	}
+
+	VEC_DISPATCH_KERNELS (generic, )
+#ifdef VECTOR3_DISPATCH_X86
+	VEC_DISPATCH_KERNELS (avx2, VEC_TARGET_AVX2)
+	VEC_DISPATCH_KERNELS (avx512, VEC_TARGET_AVX512)
+#endif
+
+	#undef VEC_DISPATCH_KERNELS
+
+	// The best level this CPU supports.
+	//
+	inline Level Detect () {
+#ifdef VECTOR3_DISPATCH_X86
+		__builtin_cpu_init ();
+		if (__builtin_cpu_supports ("avx512f")) return AVX512;
+		if (__builtin_cpu_supports ("avx2") && __builtin_cpu_supports ("fma")) return AVX2; // built with both
+#endif
+		return Generic; }
+
+	// The kernels of a level; levels this build has no code for, or the CPU
+	// cannot run, fall back to the next lower one.
+	//
+	template <class T> inline
+	KernelsT<T> Table (Level level) {
+		if (level > Detect ()) level = Detect ();
+#ifdef VECTOR3_DISPATCH_X86
+		if (level == AVX512) return avx512::Table<T> (AVX512);
+		if (level == AVX2) return avx2::Table<T> (AVX2);
+#endif
+		return generic::Table<T> (Generic); }
+
+	// The kernels bound for this process, detected on first use.
+	//
+	template <class T> inline
+	KernelsT<T>& Kernels () {
+		static KernelsT<T> k = Table<T> (Detect ());
+		return k; }
+
+	// Rebinds the process kernels to a level (clamped to what the CPU
+	// supports), e.g. to compare levels. Not thread-safe with concurrent
+	// kernel calls.
+	//
+	template <class T> inline
+	void Bind (Level level) {Kernels<T> () = Table<T> (level);}
+
+	// Readable level name.
+	//
+	inline char const* Name (Level level) {
+		switch (level) {
+		case AVX512: return "avx512";
+		case AVX2: return "avx2";
+		default: break; }
+#if defined(__aarch64__) || defined(__ARM_NEON)
+		return "neon";
+#elif defined(VECTOR3_HAS_SSE2)
+		return "sse2";
+#else
+		return "scalar";
+#endif
+	}
+
+	// Dispatched batch functions over Vector3SoAT containers, with the same
+	// contracts as the inline ones in Vector3SoA.h.
+	//
+	template <class T> inline
+	void Dot (Vector3SoAT<T> const& l, Vector3SoAT<T> const& r, T* out) {
+		assert (l.Size () == r.Size ());
+		Kernels<T> ().Dot (l.X (), l.Y (), l.Z (), r.X (), r.Y (), r.Z (), out, l.Size ()); }
+
+	template <class T> inline
+	void Cross (Vector3SoAT<T> const& l, Vector3SoAT<T> const& r, Vector3SoAT<T>& out) {
+		assert (l.Size () == r.Size ());
+		if (&out == &l || &out == &r) {Vector3SoAT<T> t; dispatch::Cross (l, r, t); out = t; return;}
+		out.Resize (l.Size ());
+		Kernels<T> ().Cross (l.X (), l.Y (), l.Z (), r.X (), r.Y (), r.Z (), out.X (), out.Y (), out.Z (), l.Size ()); }
+
+	template <class T> inline
+	void Normalize (Vector3SoAT<T>& v) {
+		Kernels<T> ().Normalize (v.X (), v.Y (), v.Z (), v.Size ()); }
+
+	template <class T> inline
+	void Distance (Vector3SoAT<T> const& l, Vector3SoAT<T> const& r, T* out) {
+		assert (l.Size () == r.Size ());
+		Kernels<T> ().Distance (l.X (), l.Y (), l.Z (), r.X (), r.Y (), r.Z (), out, l.Size ()); }
+}
+}
+
+#endif // VECTOR3_DISPATCH_H
@@ -0,0 +1,210 @@
+#ifndef VECTOR3_EXPR_H
+#define VECTOR3_EXPR_H
+
+#include <cstddef> // size_t
+#include <cassert>
+
+#include "Vector3.h"
+#include "Vector3SoA.h"
+
+// ************************************************************************************
+// Vec::expr namespace - Opt-in expression templates for Vector3 arithmetic.
+//
+// Operands are wrapped with expr::ref, after which +, -, unary -, scalar * and
+// scalar / build an expression tree instead of temporaries. The tree is
+// evaluated component by component in a single pass by Eval or Assign:
+//
+//     Vector3 r = expr::Eval (expr::ref (a)*s + expr::ref (b) - expr::ref (c)*t);
+//     expr::Assign (out, expr::ref (soa)*s + expr::ref (b));   // one fused loop
+//
+// Single vectors broadcast against batch operands (Vector3SoAT containers or
+// Vector3T arrays), so every batch operand of one expression must have the
+// same size.
+//
+// ************************************************************************************
+//
+namespace Vec
+{
+namespace expr
+{
+	// Base of every expression node. E provides Scalar, X(i), Y(i), Z(i) and
+	// Size() (0 for expressions made only of single vectors).
+	//
+	template <class E>
+	struct Expr
+	{
+		E const& Self () const {return static_cast<E const&> (*this);}
+	};
+
+	namespace detail
+	{
+		inline size_t size (size_t l, size_t r) {
+			assert (l == 0 || r == 0 || l == r);
+			return l ? l : r; }
+	}
+
+	// Leaves.
+	//
+	// A single vector, broadcast over every element.
+	//
+	template <class T>
+	struct Ref : Expr<Ref<T> >
+	{
+		typedef T Scalar;
+		Vector3T<T> const& v;
+		explicit Ref (Vector3T<T> const& v) : v(v) {}
+		T X (size_t) const {return v.x;}
+		T Y (size_t) const {return v.y;}
+		T Z (size_t) const {return v.z;}
+		size_t Size () const {return 0;}
+	};
+
+	// The streams of a Vector3SoAT container.
+	//
+	template <class T>
+	struct Streams : Expr<Streams<T> >
+	{
+		typedef T Scalar;
+		T const* x; T const* y; T const* z; size_t n;
+		explicit Streams (Vector3SoAT<T> const& s) : x(s.X ()), y(s.Y ()), z(s.Z ()), n(s.Size ()) {}
+		T X (size_t i) const {return x[i];}
+		T Y (size_t i) const {return y[i];}
+		T Z (size_t i) const {return z[i];}
+		size_t Size () const {return n;}
+	};
+
+	// An array of Vector3T.
+	//
+	template <class T>
+	struct Array : Expr<Array<T> >
+	{
+		typedef T Scalar;
+		Vector3T<T> const* p; size_t n;
+		Array (Vector3T<T> const* p, size_t n) : p(p), n(n) {}
+		T X (size_t i) const {return p[i].x;}
+		T Y (size_t i) const {return p[i].y;}
+		T Z (size_t i) const {return p[i].z;}
+		size_t Size () const {return n;}
+	};
+
+	// Wraps an operand.
+	//
+	template <class T> inline Ref<T> ref (Vector3T<T> const& v) {return Ref<T> (v);}
+	template <class T> inline Streams<T> ref (Vector3SoAT<T> const& s) {return Streams<T> (s);}
+	template <class T> inline Array<T> ref (Vector3T<T> const* p, size_t n) {return Array<T> (p, n);}
+
+	// Nodes.
+	//
+	template <class L, class R>
+	struct Add : Expr<Add<L, R> >
+	{
+		typedef typename L::Scalar Scalar;
+		L l; R r;
+		Add (L const& l, R const& r) : l(l), r(r) {}
+		Scalar X (size_t i) const {return l.X (i) + r.X (i);}
+		Scalar Y (size_t i) const {return l.Y (i) + r.Y (i);}
+		Scalar Z (size_t i) const {return l.Z (i) + r.Z (i);}
+		size_t Size () const {return detail::size (l.Size (), r.Size ());}
+	};
+
+	template <class L, class R>
+	struct Sub : Expr<Sub<L, R> >
+	{
+		typedef typename L::Scalar Scalar;
+		L l; R r;
+		Sub (L const& l, R const& r) : l(l), r(r) {}
+		Scalar X (size_t i) const {return l.X (i) - r.X (i);}
+		Scalar Y (size_t i) const {return l.Y (i) - r.Y (i);}
+		Scalar Z (size_t i) const {return l.Z (i) - r.Z (i);}
+		size_t Size () const {return detail::size (l.Size (), r.Size ());}
+	};
+
+	// Scaling; division is stored as multiplication by the reciprocal,
+	// matching Vector3T::operator/=.
+	//
+	template <class E>
+	struct Scale : Expr<Scale<E> >
+	{
+		typedef typename E::Scalar Scalar;
+		E e; Scalar s;
+		Scale (E const& e, Scalar s) : e(e), s(s) {}
+		Scalar X (size_t i) const {return s * e.X (i);}
+		Scalar Y (size_t i) const {return s * e.Y (i);}
+		Scalar Z (size_t i) const {return s * e.Z (i);}
+		size_t Size () const {return e.Size ();}
+	};
+
+	template <class E>
+	struct Neg : Expr<Neg<E> >
+	{
+		typedef typename E::Scalar Scalar;
+		E e;
+		explicit Neg (E const& e) : e(e) {}
+		Scalar X (size_t i) const {return -e.X (i);}
+		Scalar Y (size_t i) const {return -e.Y (i);}
+		Scalar Z (size_t i) const {return -e.Z (i);}
+		size_t Size () const {return e.Size ();}
+	};
+
+	// Operators.
+	//
+	template <class L, class R> inline
+	Add<L, R> operator+ (Expr<L> const& l, Expr<R> const& r) {return Add<L, R> (l.Self (), r.Self ());}
+
+	template <class L, class R> inline
+	Sub<L, R> operator- (Expr<L> const& l, Expr<R> const& r) {return Sub<L, R> (l.Self (), r.Self ());}
+
+	template <class E> inline
+	Neg<E> operator- (Expr<E> const& e) {return Neg<E> (e.Self ());}
+
+	template <class E> inline
+	Scale<E> operator* (Expr<E> const& e, typename E::Scalar s) {return Scale<E> (e.Self (), s);}
+
+	template <class E> inline
+	Scale<E> operator* (typename E::Scalar s, Expr<E> const& e) {return Scale<E> (e.Self (), s);}
+
+	template <class E> inline
+	Scale<E> operator/ (Expr<E> const& e, typename E::Scalar s) {return Scale<E> (e.Self (), typename E::Scalar(1)/s);}
+
+	// Evaluation.
+	//
+	// Evaluates an expression of single vectors (or element i of a batch one).
+	//
+	template <class E> inline
+	Vector3T<typename E::Scalar> Eval (Expr<E> const& e, size_t i = 0) {
+		E const& x = e.Self ();
+		return Vector3T<typename E::Scalar> (x.X (i), x.Y (i), x.Z (i)); }
+
+	// Stores an expression of single vectors.
+	//
+	template <class E> inline
+	void Assign (Vector3T<typename E::Scalar>& out, Expr<E> const& e) {out = Eval (e);}
+
+	// Evaluates a batch expression into a container in one loop; out is
+	// resized to the expression size (a single-vector expression fills the
+	// current size) and may also appear as an operand.
+	//
+	template <class E> inline
+	void Assign (Vector3SoAT<typename E::Scalar>& out, Expr<E> const& e) {
+		typedef typename E::Scalar T;
+		E const& x = e.Self ();
+		size_t const n = x.Size ();
+		if (n) out.Resize (n);
+		T* ox = out.X (); T* oy = out.Y (); T* oz = out.Z ();
+		for (size_t i = 0, m = out.Size (); i < m; ++i) {
+			T vx = x.X (i), vy = x.Y (i), vz = x.Z (i);
+			ox[i] = vx; oy[i] = vy; oz[i] = vz; } }
+
+	// Evaluates a batch expression into an array of n vectors.
+	//
+	template <class E> inline
+	void Assign (Vector3T<typename E::Scalar>* out, size_t n, Expr<E> const& e) {
+		E const& x = e.Self ();
+		assert (x.Size () == 0 || x.Size () == n);
+		for (size_t i = 0; i < n; ++i) {
+			typename E::Scalar vx = x.X (i), vy = x.Y (i), vz = x.Z (i);
+			out[i].x = vx; out[i].y = vy; out[i].z = vz; } }
+}
+}
+
+#endif // VECTOR3_EXPR_H
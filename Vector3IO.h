@@ -0,0 +1,125 @@
+#ifndef VECTOR3_IO_H
+#define VECTOR3_IO_H
+
+#if __cplusplus < 201703L && !(defined(_MSVC_LANG) && _MSVC_LANG >= 201703L)
+	#error "Vector3IO.h needs C++17 (std::from_chars/std::to_chars)"
+#endif
+
+#include <cstddef> // size_t
+#include <charconv>
+#include <string_view>
+#include <system_error>
+
+#include "Vector3.h"
+
+// ************************************************************************************
+// Vec namespace - Text conversion of Vector3T.
+//
+// Built on std::from_chars/std::to_chars: no locale, no allocation, no
+// iostreams. Text is three numbers separated by any mix of spaces, tabs,
+// commas, semicolons and line breaks (so CSV, XYZ and the body of a PLY
+// ASCII file whose vertices have only x, y and z all parse; further vertex
+// properties such as normals or colours would be read as more vectors). A
+// leading '+' is accepted, but not one followed by another sign. Formatting
+// writes the shortest text that reads back to the identical value, so
+// Format followed by Parse round-trips exactly.
+//
+// ************************************************************************************
+//
+namespace Vec
+{
+	namespace detail
+	{
+		inline bool is_separator (char c) {
+			return c == ' ' || c == '\t' || c == ',' || c == ';' || c == '\n' || c == '\r' || c == '\f' || c == '\v';}
+
+		inline char const* skip_separators (char const* p, char const* last) {
+			while (p != last && is_separator (*p)) ++p;
+			return p; }
+
+		template <class T> inline
+		char const* parse_scalar (char const* p, char const* last, T& x) {
+			p = skip_separators (p, last);
+			if (p != last && *p == '+') {
+				++p;
+				if (p != last && (*p == '-' || *p == '+')) return 0; }
+			std::from_chars_result r = std::from_chars (p, last, x);
+			return r.ec == std::errc () ? r.ptr : 0; }
+	}
+
+	// Most characters Format writes for one vector (three shortest values
+	// and two separators).
+	//
+	template <class T>
+	struct FormatSize
+	{
+		static const size_t value = 3 * (sizeof (T) == 4 ? 15 : 24) + 2;
+	};
+
+	// Parses one vector from [first, last), skipping leading separators.
+	// Returns the position after it, or null when there is no valid vector
+	// (v is then unspecified).
+	//
+	template <class T> inline
+	char const* Parse (char const* first, char const* last, Vector3T<T>& v) {
+		if (!(first = detail::parse_scalar (first, last, v.x))) return 0;
+		if (!(first = detail::parse_scalar (first, last, v.y))) return 0;
+		return detail::parse_scalar (first, last, v.z); }
+
+	// Parses a string holding exactly one vector (separators around it are
+	// allowed).
+	//
+	template <class T> inline
+	bool Parse (std::string_view s, Vector3T<T>& v) {
+		char const* last = s.data () + s.size ();
+		char const* p = Parse (s.data (), last, v);
+		return p && detail::skip_separators (p, last) == last; }
+
+	// Parses up to max consecutive vectors into out. Stops at the end of the
+	// text or at the first thing that is not a vector; *end (when not null)
+	// gets the position after the last vector parsed. Returns the count.
+	//
+	template <class T> inline
+	size_t ParseMany (std::string_view s, Vector3T<T>* out, size_t max, char const** end = 0) {
+		char const* p = s.data ();
+		char const* const last = p + s.size ();
+		size_t n = 0;
+		for (; n < max; ++n) {
+			char const* q = Parse (p, last, out[n]);
+			if (!q) break;
+			p = q; }
+		if (end) *end = p;
+		return n; }
+
+	// Writes v as "x y z" (sep between the values) into [first, last).
+	// Returns the end of the text, or null when it does not fit.
+	//
+	template <class T> inline
+	char* Format (char* first, char* last, Vector3T<T> const& v, char sep = ' ') {
+		T const c[3] = {v.x, v.y, v.z};
+		for (int a = 0; a < 3; ++a) {
+			if (a) {
+				if (first == last) return 0;
+				*first++ = sep; }
+			std::to_chars_result r = std::to_chars (first, last, c[a]);
+			if (r.ec != std::errc ()) return 0;
+			first = r.ptr; }
+		return first; }
+
+	// Writes n vectors, each followed by eol, into [first, last). Stops
+	// before the first vector that does not fit; *written (when not null)
+	// gets the number written. Returns the end of the text.
+	//
+	template <class T> inline
+	char* FormatMany (char* first, char* last, Vector3T<T> const* v, size_t n, size_t* written = 0, char sep = ' ', char eol = '\n') {
+		size_t i = 0;
+		for (; i < n; ++i) {
+			char* p = Format (first, last, v[i], sep);
+			if (!p || p == last) break;
+			*p++ = eol;
+			first = p; }
+		if (written) *written = i;
+		return first; }
+}
+
+#endif // VECTOR3_IO_H
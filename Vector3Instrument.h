@@ -0,0 +1,212 @@
+#ifndef VECTOR3_INSTRUMENT_H
+#define VECTOR3_INSTRUMENT_H
+
+#include <cstddef> // size_t
+#include <cstdint>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <mutex>
+#include <vector>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+	#include <intrin.h>
+	#define VECTOR3_HAS_RDTSC
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+	#include <x86intrin.h>
+	#define VECTOR3_HAS_RDTSC
+#endif
+
+// ************************************************************************************
+// Vec::instrument namespace - Call, element and time counters for Vec operations.
+//
+// Define VECTOR3_INSTRUMENT before including Vector3.h to count. Without it
+// the hooks in Vector3.h, Vector3Batch.h, Transform.h and Vector3Reduce.h
+// expand to nothing. Every thread counts into its own counters; Collect
+// merges those of the live threads and of the threads that have exited.
+//
+//   calls       calls of the operation (scalar normalizations count each
+//               vector, batch kernels each call)
+//   elements    vectors processed
+//   degenerate  normalizations whose squared length is zero, subnormal or
+//               NaN (below numeric_limits<T>::min (), so lengths under
+//               about 1e-19 for float and 1e-154 for double; the vectors
+//               NormalizeSafe rejects at the low end)
+//   nonFinite   normalizations with an infinite or NaN result
+//   ticks       time inside batch kernels, in TSC ticks on x86 and
+//               nanoseconds elsewhere (see TicksAreCycles)
+//
+// A batch kernel is timed on the thread that calls it, from entry to return,
+// so the time covers the work of the pool threads it waits for.
+//
+// ************************************************************************************
+//
+namespace Vec
+{
+namespace instrument
+{
+	enum Op
+	{
+		OpNormalize, OpNormalizeFast, OpNormalizeSafe,
+		OpBatchNormalize, OpBatchNormalizeFast, OpBatchNormalizeSafe, OpBatchUnit, OpBatchToPoint2D,
+		OpBatchDistance, OpBatchDistanceSq, OpBatchDot, OpBatchAffine, OpBatchAxpy,
+		OpBatchNearlyEqual, OpBatchUlpEqual, OpBatchMoved,
+		OpTransformPoints, OpTransformDirections, OpRotate,
+		OpSum, OpBounds, OpMinMaxLengthSq,
+		OpCount
+	};
+
+	inline char const* Name (Op op) {
+		static char const* const names[OpCount] = {
+			"Normalize", "NormalizeFast", "NormalizeSafe",
+			"batch::Normalize", "batch::NormalizeFast", "batch::NormalizeSafe", "batch::Unit", "batch::ToPoint2D",
+			"batch::Distance", "batch::DistanceSq", "batch::Dot", "batch::Affine", "batch::Axpy",
+			"batch::NearlyEqual", "batch::UlpEqual", "batch::Moved",
+			"TransformPoints", "TransformDirections", "Rotate",
+			"Sum", "Bounds", "MinMaxLengthSq"};
+		return op >= 0 && op < OpCount ? names[op] : "";}
+
+	struct Counters
+	{
+		uint64_t calls, elements, degenerate, nonFinite, ticks;
+	};
+
+	// All counters at one point in time.
+	//
+	struct Snapshot
+	{
+		Counters op[OpCount];
+
+		Counters const& operator[] (Op o) const {return op[o];}
+	};
+
+	// True when ticks are TSC cycles rather than nanoseconds.
+	//
+#ifdef VECTOR3_HAS_RDTSC
+	const bool TicksAreCycles = true;
+	inline uint64_t Ticks () {return __rdtsc ();}
+#else
+	const bool TicksAreCycles = false;
+	inline uint64_t Ticks () {
+		return uint64_t (std::chrono::duration_cast<std::chrono::nanoseconds> (std::chrono::steady_clock::now ().time_since_epoch ()).count ());}
+#endif
+
+	namespace detail
+	{
+		static const int Fields = 5;
+
+		// One thread's counters. Only the owning thread writes them, so an
+		// update is a relaxed load and store; Collect reads them concurrently.
+		//
+		struct Local
+		{
+			std::atomic<uint64_t> c[OpCount][Fields];
+
+			Local ();
+			~Local ();
+
+			void Add (Op op, int field, uint64_t v) {
+				std::atomic<uint64_t>& a = c[op][field];
+				a.store (a.load (std::memory_order_relaxed) + v, std::memory_order_relaxed); }
+		};
+
+		struct Registry
+		{
+			std::mutex mutex;
+			std::vector<Local*> live;
+			uint64_t retired[OpCount][Fields]; // counts of exited threads
+			uint64_t base[OpCount][Fields];    // totals at the last Reset
+
+			Registry () {
+				for (int o = 0; o < OpCount; ++o)
+					for (int f = 0; f < Fields; ++f) retired[o][f] = base[o][f] = 0; }
+
+			// Never destroyed: pool threads may exit during static destruction.
+			//
+			static Registry& Get () {static Registry* r = new Registry; return *r;}
+
+			// Totals over all threads; the caller holds the mutex.
+			//
+			void Totals (uint64_t t[OpCount][Fields]) const {
+				for (int o = 0; o < OpCount; ++o)
+					for (int f = 0; f < Fields; ++f) {
+						uint64_t s = retired[o][f];
+						for (size_t i = 0; i < live.size (); ++i) s += live[i]->c[o][f].load (std::memory_order_relaxed);
+						t[o][f] = s; } }
+		};
+
+		inline Local::Local () {
+			for (int o = 0; o < OpCount; ++o)
+				for (int f = 0; f < Fields; ++f) c[o][f].store (0, std::memory_order_relaxed);
+			Registry& r = Registry::Get ();
+			std::lock_guard<std::mutex> lock (r.mutex);
+			r.live.push_back (this); }
+
+		inline Local::~Local () {
+			Registry& r = Registry::Get ();
+			std::lock_guard<std::mutex> lock (r.mutex);
+			for (int o = 0; o < OpCount; ++o)
+				for (int f = 0; f < Fields; ++f) r.retired[o][f] += c[o][f].load (std::memory_order_relaxed);
+			for (size_t i = 0; i < r.live.size (); ++i)
+				if (r.live[i] == this) {r.live[i] = r.live.back (); r.live.pop_back (); break;} }
+
+		inline Local& local () {
+			thread_local Local l;
+			return l; }
+	}
+
+	// The counts since the last Reset, over all threads.
+	//
+	inline Snapshot Collect () {
+		detail::Registry& r = detail::Registry::Get ();
+		uint64_t t[OpCount][detail::Fields];
+		Snapshot s;
+		std::lock_guard<std::mutex> lock (r.mutex); // Reset writes base
+		r.Totals (t);
+		for (int o = 0; o < OpCount; ++o) {
+			uint64_t const* b = r.base[o];
+			Counters c = {t[o][0] - b[0], t[o][1] - b[1], t[o][2] - b[2], t[o][3] - b[3], t[o][4] - b[4]};
+			s.op[o] = c; }
+		return s; }
+
+	// Starts counting from zero. Thread counters are never written by other
+	// threads; Reset records the current totals as the new origin.
+	//
+	inline void Reset () {
+		detail::Registry& r = detail::Registry::Get ();
+		std::lock_guard<std::mutex> lock (r.mutex);
+		r.Totals (r.base); }
+
+	// Hooks.
+	//
+	template <class T> inline
+	void CountNormalize (Op op, T lengthSq, T x, T y, T z) {
+		detail::Local& l = detail::local ();
+		l.Add (op, 0, 1); l.Add (op, 1, 1);
+		if (!(lengthSq >= std::numeric_limits<T>::min ())) l.Add (op, 2, 1);
+		if (!(std::isfinite (x) && std::isfinite (y) && std::isfinite (z))) l.Add (op, 3, 1); }
+
+	// Counts one call over n elements and the time until it is destroyed.
+	//
+	class Timer
+	{
+	public:
+		Timer (Op op, size_t n) : op(op), n(n), start(Ticks ()) {}
+		~Timer () {
+			uint64_t t = Ticks () - start;
+			detail::Local& l = detail::local ();
+			l.Add (op, 0, 1); l.Add (op, 1, n); l.Add (op, 4, t); }
+
+	private:
+		Timer (Timer const&);
+		Timer& operator= (Timer const&);
+
+		Op op;
+		size_t n;
+		uint64_t start;
+	};
+}
+}
+
+#endif // VECTOR3_INSTRUMENT_H
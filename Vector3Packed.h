@@ -0,0 +1,369 @@
+#ifndef VECTOR3_PACKED_H
+#define VECTOR3_PACKED_H
+
+#include <cstddef> // size_t
+#include <cstdint>
+#include <cstring>
+
+#include "Vector3.h"
+#include "Box3.h"
+#include "Vector3Batch.h"
+
+// Half-float conversion instructions (-mf16c, implied by AVX2 on MSVC).
+//
+#if defined(VECTOR3_HAS_SSE2) && (defined(__F16C__) || (defined(_MSC_VER) && defined(__AVX2__)))
+	#define VECTOR3_HAS_F16C
+	#include <immintrin.h>
+#endif
+
+// ************************************************************************************
+// Packed Vector3 storage - Compact encodings for bandwidth-bound passes.
+//
+//   Fixed16x3  6 bytes   16-bit fixed point within a box (QuantizerT); the
+//                        error is half a step, extent / 131070 per axis, plus
+//                        the rounding of the arithmetic in T (about an ulp
+//                        of the coordinate, which matters for float).
+//   Oct32      4 bytes   unit vectors, octahedral map with 16-bit snorm
+//                        coordinates; the angular error is below 0.004 degrees.
+//   Half3      6 bytes   IEEE half floats, 11 significant bits (fewer below
+//                        6.1e-5), range 65504.
+//
+// Vec::batch::Pack and Unpack convert arrays in either direction; the float
+// versions work four vectors per SSE2 step (F16C for Half3), doubles use the
+// scalar functions. Packing rounds to nearest, NaN packs as the box minimum
+// (Fixed16x3), +z (Oct32) or NaN (Half3).
+//
+// ************************************************************************************
+//
+namespace Vec
+{
+	struct Fixed16x3 {uint16_t x, y, z;};
+	struct Oct32 {int16_t u, v;};
+	struct Half3 {uint16_t x, y, z;};
+
+	static_assert (sizeof (Fixed16x3) == 6 && sizeof (Oct32) == 4 && sizeof (Half3) == 6, "Packed layouts");
+
+	// Maps a box onto the 65536^3 grid of Fixed16x3. Points outside the box
+	// are clamped to it; a flat axis packs to 0.
+	//
+	template <class T>
+	class QuantizerT
+	{
+	public:
+		explicit QuantizerT (Box3T<T> const& box) : origin(box.min), step(box.Extent () / T(65535)),
+			scale(inverse (step.x), inverse (step.y), inverse (step.z)) {}
+
+		Fixed16x3 Pack (Vector3T<T> const& v) const {
+			Fixed16x3 q = {quantize ((v.x - origin.x) * scale.x), quantize ((v.y - origin.y) * scale.y), quantize ((v.z - origin.z) * scale.z)};
+			return q; }
+
+		Vector3T<T> Unpack (Fixed16x3 const& q) const {
+			return Vector3T<T> (origin.x + T(q.x) * step.x, origin.y + T(q.y) * step.y, origin.z + T(q.z) * step.z); }
+
+		// The box minimum, the size of one grid step per axis and its inverse.
+		//
+		Vector3T<T> const& Origin () const {return origin;}
+		Vector3T<T> const& Step () const {return step;}
+		Vector3T<T> const& Scale () const {return scale;}
+
+	private:
+		static T inverse (T s) {return s > T(0) ? T(1) / s : T(0);}
+
+		// Clamps to [0, 65535] (NaN to 0) and rounds half up.
+		//
+		static uint16_t quantize (T f) {
+			f = f > T(0) ? f : T(0);
+			f = f < T(65535) ? f : T(65535);
+			return uint16_t (f + T(0.5)); }
+
+		Vector3T<T> origin, step, scale;
+	};
+
+	// The FLOAT_TYPE quantizer.
+	//
+	typedef QuantizerT<Scalar> Quantizer;
+
+	// Octahedral encoding of unit vectors: v / (|x| + |y| + |z|) projected
+	// on the octahedron, the lower half folded over the upper one. Inputs
+	// need not be exactly unit length; UnpackOct returns unit vectors.
+	//
+	template <class T> inline Oct32 PackOct (Vector3T<T> const& n) {
+		T s = std::fabs (n.x) + std::fabs (n.y) + std::fabs (n.z);
+		T inv = s > T(0) ? T(1) / s : T(0);
+		T u = n.x * inv, v = n.y * inv;
+		T fu = (T(1) - std::fabs (v)) * (u >= T(0) ? T(1) : T(-1));
+		T fv = (T(1) - std::fabs (u)) * (v >= T(0) ? T(1) : T(-1));
+		bool lower = n.z < T(0);
+		u = lower ? fu : u; v = lower ? fv : v;
+		u = u == u ? u : T(0); v = v == v ? v : T(0);
+		u = u > T(-1) ? (u < T(1) ? u : T(1)) : T(-1);
+		v = v > T(-1) ? (v < T(1) ? v : T(1)) : T(-1);
+		// Adding and subtracting 1.5 * 2^(digits-1) rounds to nearest even,
+		// as cvtps does, without a call to lrint.
+		T const magic = T(1.5) * T(uint64_t(1) << (std::numeric_limits<T>::digits - 1));
+		Oct32 o = {int16_t ((u * T(32767) + magic) - magic), int16_t ((v * T(32767) + magic) - magic)};
+		return o; }
+
+	template <class T> inline Vector3T<T> UnpackOct (Oct32 const& o) {
+		T u = T(o.u) * T(1.0 / 32767), v = T(o.v) * T(1.0 / 32767);
+		u = u > T(-1) ? u : T(-1); v = v > T(-1) ? v : T(-1);
+		T z = T(1) - std::fabs (u) - std::fabs (v);
+		T t = -z > T(0) ? -z : T(0);
+		u += u >= T(0) ? -t : t;
+		v += v >= T(0) ? -t : t;
+		Vector3T<T> n (u, v, z);
+		n.Normalize ();
+		return n; }
+
+	// IEEE 754 binary16 conversion, rounding to nearest even. Overflow gives
+	// infinity and NaN stays NaN.
+	//
+	inline uint16_t FloatToHalf (float f) {
+		uint32_t i; std::memcpy (&i, &f, sizeof i);
+		uint32_t sign = (i >> 16) & 0x8000u;
+		i &= 0x7fffffffu;
+		// Subnormal halves: adding 0.5f aligns the significand so the FPU does
+		// the rounding.
+		float a; std::memcpy (&a, &i, sizeof a);
+		a += 0.5f;
+		uint32_t sub; std::memcpy (&sub, &a, sizeof sub);
+		sub -= 0x3f000000u;
+		uint32_t norm = (i + 0xc8000fffu + ((i >> 13) & 1)) >> 13;
+		uint32_t h = i >= 0x47800000u ? (i > 0x7f800000u ? 0x7e00u : 0x7c00u) : (i < 0x38800000u ? sub : norm);
+		return uint16_t (h | sign); }
+
+	inline float HalfToFloat (uint16_t h) {
+		uint32_t i = uint32_t (h & 0x7fffu) << 13;
+		uint32_t exp = i & 0x0f800000u;
+		i += 0x38000000u;
+		i += exp == 0x0f800000u ? 0x38000000u : 0u;         // infinity and NaN
+		float f; std::memcpy (&f, &i, sizeof f);
+		uint32_t j = i + 0x00800000u;                       // subnormal: renormalize
+		float g; std::memcpy (&g, &j, sizeof g);
+		g -= 6.103515625e-05f;
+		f = exp == 0 ? g : f;
+		std::memcpy (&i, &f, sizeof i);
+		i |= uint32_t (h & 0x8000u) << 16;
+		std::memcpy (&f, &i, sizeof f);
+		return f; }
+
+	// Doubles round through float, so a double exactly halfway between two
+	// halves after the float rounding may pack one half ulp differently.
+	//
+	template <class T> inline Half3 PackHalf (Vector3T<T> const& v) {
+		Half3 h = {FloatToHalf (float (v.x)), FloatToHalf (float (v.y)), FloatToHalf (float (v.z))};
+		return h; }
+
+	template <class T> inline Vector3T<T> UnpackHalf (Half3 const& h) {
+		return Vector3T<T> (T(HalfToFloat (h.x)), T(HalfToFloat (h.y)), T(HalfToFloat (h.z))); }
+}
+
+
+// ************************************************************************************
+// Vec::batch namespace - Packing and unpacking of Vector3T arrays.
+//
+//
+// ************************************************************************************
+//
+namespace Vec
+{
+namespace batch
+{
+	namespace detail
+	{
+		template <class T> inline
+		void pack (Vector3T<T> const* v, size_t n, QuantizerT<T> const& q, Fixed16x3* out) {
+			for (size_t i = 0; i < n; ++i) out[i] = q.Pack (v[i]); }
+
+		template <class T> inline
+		void unpack (Fixed16x3 const* in, size_t n, QuantizerT<T> const& q, Vector3T<T>* out) {
+			for (size_t i = 0; i < n; ++i) out[i] = q.Unpack (in[i]); }
+
+		template <class T> inline
+		void pack (Vector3T<T> const* v, size_t n, Oct32* out) {
+			for (size_t i = 0; i < n; ++i) out[i] = PackOct (v[i]); }
+
+		template <class T> inline
+		void unpack (Oct32 const* in, size_t n, Vector3T<T>* out) {
+			for (size_t i = 0; i < n; ++i) out[i] = UnpackOct<T> (in[i]); }
+
+		template <class T> inline
+		void pack (Vector3T<T> const* v, size_t n, Half3* out) {
+			for (size_t i = 0; i < n; ++i) out[i] = PackHalf (v[i]); }
+
+		template <class T> inline
+		void unpack (Half3 const* in, size_t n, Vector3T<T>* out) {
+			for (size_t i = 0; i < n; ++i) out[i] = UnpackHalf<T> (in[i]); }
+
+#ifdef VECTOR3_HAS_SSE2
+		// Four float vectors as three registers (x0 y0 z0 x1 | y1 z1 x2 y2 |
+		// z2 x3 y3 z3) to and from one register per component.
+		//
+		inline void load_xyz4 (float const* p, __m128& x, __m128& y, __m128& z) {
+			__m128 a = _mm_loadu_ps (p), b = _mm_loadu_ps (p + 4), c = _mm_loadu_ps (p + 8);
+			x = _mm_shuffle_ps (a, _mm_shuffle_ps (b, c, _MM_SHUFFLE (1, 1, 2, 2)), _MM_SHUFFLE (2, 0, 3, 0));
+			y = _mm_shuffle_ps (_mm_shuffle_ps (a, b, _MM_SHUFFLE (0, 0, 1, 1)), _mm_shuffle_ps (b, c, _MM_SHUFFLE (2, 2, 3, 3)), _MM_SHUFFLE (2, 0, 2, 0));
+			z = _mm_shuffle_ps (_mm_shuffle_ps (a, b, _MM_SHUFFLE (1, 1, 2, 2)), _mm_shuffle_ps (c, c, _MM_SHUFFLE (3, 3, 0, 0)), _MM_SHUFFLE (2, 0, 2, 0)); }
+
+		inline void store_xyz4 (float* p, __m128 x, __m128 y, __m128 z) {
+			_mm_storeu_ps (p, _mm_shuffle_ps (_mm_shuffle_ps (x, y, _MM_SHUFFLE (0, 0, 0, 0)), _mm_shuffle_ps (z, x, _MM_SHUFFLE (1, 1, 0, 0)), _MM_SHUFFLE (2, 0, 2, 0)));
+			_mm_storeu_ps (p + 4, _mm_shuffle_ps (_mm_shuffle_ps (y, z, _MM_SHUFFLE (1, 1, 1, 1)), _mm_shuffle_ps (x, y, _MM_SHUFFLE (2, 2, 2, 2)), _MM_SHUFFLE (2, 0, 2, 0)));
+			_mm_storeu_ps (p + 8, _mm_shuffle_ps (_mm_shuffle_ps (z, x, _MM_SHUFFLE (3, 3, 2, 2)), _mm_shuffle_ps (y, z, _MM_SHUFFLE (3, 3, 3, 3)), _MM_SHUFFLE (2, 0, 2, 0))); }
+
+		// The box origin and scale repeat every three lanes; these are their
+		// four-lane phases for the three registers of four vectors.
+		//
+		inline void phases (Vector3T<float> const& v, __m128& a, __m128& b, __m128& c) {
+			a = _mm_setr_ps (v.x, v.y, v.z, v.x); b = _mm_setr_ps (v.y, v.z, v.x, v.y); c = _mm_setr_ps (v.z, v.x, v.y, v.z); }
+
+		// QuantizerT::quantize on four lanes, as int32.
+		//
+		inline __m128i quantize (__m128 f) {
+			f = _mm_min_ps (_mm_max_ps (f, _mm_setzero_ps ()), _mm_set1_ps (65535.0f));
+			return _mm_cvttps_epi32 (_mm_add_ps (f, _mm_set1_ps (0.5f))); }
+
+		// Packs eight int32 in [0, 65535] to uint16 (packus_epi32 is SSE4.1).
+		//
+		inline __m128i pack_u16 (__m128i a, __m128i b) {
+			__m128i bias = _mm_set1_epi32 (32768);
+			return _mm_xor_si128 (_mm_packs_epi32 (_mm_sub_epi32 (a, bias), _mm_sub_epi32 (b, bias)), _mm_set1_epi16 (short (0x8000))); }
+
+		// Twelve quantized components (four vectors, 24 bytes) per step.
+		//
+		inline void pack (Vector3T<float> const* v, size_t n, QuantizerT<float> const& q, Fixed16x3* out) {
+			__m128 oa, ob, oc, sa, sb, sc;
+			phases (q.Origin (), oa, ob, oc); phases (q.Scale (), sa, sb, sc);
+			float const* p = &v[0].x;
+			char* o = reinterpret_cast<char*> (out);
+			size_t i = 0;
+			for (; i + 4 <= n; i += 4, p += 12, o += 24) {
+				__m128i a = quantize (_mm_mul_ps (_mm_sub_ps (_mm_loadu_ps (p), oa), sa));
+				__m128i b = quantize (_mm_mul_ps (_mm_sub_ps (_mm_loadu_ps (p + 4), ob), sb));
+				__m128i c = quantize (_mm_mul_ps (_mm_sub_ps (_mm_loadu_ps (p + 8), oc), sc));
+				_mm_storeu_si128 (reinterpret_cast<__m128i*> (o), pack_u16 (a, b));
+				_mm_storel_epi64 (reinterpret_cast<__m128i*> (o + 16), pack_u16 (c, c)); }
+			for (; i < n; ++i) out[i] = q.Pack (v[i]); }
+
+		inline void unpack (Fixed16x3 const* in, size_t n, QuantizerT<float> const& q, Vector3T<float>* out) {
+			__m128 oa, ob, oc, sa, sb, sc;
+			phases (q.Origin (), oa, ob, oc); phases (q.Step (), sa, sb, sc);
+			char const* s = reinterpret_cast<char const*> (in);
+			float* p = &out[0].x;
+			__m128i const zero = _mm_setzero_si128 ();
+			size_t i = 0;
+			for (; i + 4 <= n; i += 4, s += 24, p += 12) {
+				__m128i ab = _mm_loadu_si128 (reinterpret_cast<__m128i const*> (s));
+				__m128i c = _mm_loadl_epi64 (reinterpret_cast<__m128i const*> (s + 16));
+				_mm_storeu_ps (p, _mm_add_ps (oa, _mm_mul_ps (_mm_cvtepi32_ps (_mm_unpacklo_epi16 (ab, zero)), sa)));
+				_mm_storeu_ps (p + 4, _mm_add_ps (ob, _mm_mul_ps (_mm_cvtepi32_ps (_mm_unpackhi_epi16 (ab, zero)), sb)));
+				_mm_storeu_ps (p + 8, _mm_add_ps (oc, _mm_mul_ps (_mm_cvtepi32_ps (_mm_unpacklo_epi16 (c, zero)), sc))); }
+			for (; i < n; ++i) out[i] = q.Unpack (in[i]); }
+
+		// PackOct and UnpackOct on four lanes, operation for operation, so the
+		// results are identical to the scalar ones.
+		//
+		inline __m128 abs_ps (__m128 f) {return _mm_andnot_ps (_mm_set1_ps (-0.0f), f);}
+		inline __m128 neg_ps (__m128 f) {return _mm_xor_ps (_mm_set1_ps (-0.0f), f);}
+
+		inline __m128 select_ps (__m128 mask, __m128 a, __m128 b) {return _mm_or_ps (_mm_and_ps (mask, a), _mm_andnot_ps (mask, b));}
+
+		inline void pack (Vector3T<float> const* v, size_t n, Oct32* out) {
+			__m128 const one = _mm_set1_ps (1.0f), mone = _mm_set1_ps (-1.0f), zero = _mm_setzero_ps ();
+			float const* p = &v[0].x;
+			size_t i = 0;
+			for (; i + 4 <= n; i += 4, p += 12) {
+				__m128 x, y, z;
+				load_xyz4 (p, x, y, z);
+				__m128 s = _mm_add_ps (_mm_add_ps (abs_ps (x), abs_ps (y)), abs_ps (z));
+				__m128 inv = _mm_and_ps (_mm_cmpgt_ps (s, zero), _mm_div_ps (one, s));
+				__m128 u = _mm_mul_ps (x, inv), w = _mm_mul_ps (y, inv);
+				__m128 fu = _mm_mul_ps (_mm_sub_ps (one, abs_ps (w)), select_ps (_mm_cmpge_ps (u, zero), one, mone));
+				__m128 fw = _mm_mul_ps (_mm_sub_ps (one, abs_ps (u)), select_ps (_mm_cmpge_ps (w, zero), one, mone));
+				__m128 lower = _mm_cmplt_ps (z, zero);
+				u = select_ps (lower, fu, u); w = select_ps (lower, fw, w);
+				u = _mm_and_ps (_mm_cmpord_ps (u, u), u); w = _mm_and_ps (_mm_cmpord_ps (w, w), w);
+				u = _mm_max_ps (_mm_min_ps (u, one), mone); w = _mm_max_ps (_mm_min_ps (w, one), mone);
+				__m128i qu = _mm_cvtps_epi32 (_mm_mul_ps (u, _mm_set1_ps (32767.0f)));
+				__m128i qw = _mm_cvtps_epi32 (_mm_mul_ps (w, _mm_set1_ps (32767.0f)));
+				_mm_storeu_si128 (reinterpret_cast<__m128i*> (out + i), _mm_packs_epi32 (_mm_unpacklo_epi32 (qu, qw), _mm_unpackhi_epi32 (qu, qw))); }
+			for (; i < n; ++i) out[i] = PackOct (v[i]); }
+
+		inline void unpack (Oct32 const* in, size_t n, Vector3T<float>* out) {
+			__m128 const one = _mm_set1_ps (1.0f), mone = _mm_set1_ps (-1.0f), zero = _mm_setzero_ps ();
+			float* p = &out[0].x;
+			size_t i = 0;
+			for (; i + 4 <= n; i += 4, p += 12) {
+				__m128i q = _mm_loadu_si128 (reinterpret_cast<__m128i const*> (in + i));
+				__m128 lo = _mm_castsi128_ps (_mm_srai_epi32 (_mm_unpacklo_epi16 (q, q), 16));
+				__m128 hi = _mm_castsi128_ps (_mm_srai_epi32 (_mm_unpackhi_epi16 (q, q), 16));
+				__m128 u = _mm_cvtepi32_ps (_mm_castps_si128 (_mm_shuffle_ps (lo, hi, _MM_SHUFFLE (2, 0, 2, 0))));
+				__m128 w = _mm_cvtepi32_ps (_mm_castps_si128 (_mm_shuffle_ps (lo, hi, _MM_SHUFFLE (3, 1, 3, 1))));
+				u = _mm_max_ps (_mm_mul_ps (u, _mm_set1_ps (float (1.0 / 32767))), mone);
+				w = _mm_max_ps (_mm_mul_ps (w, _mm_set1_ps (float (1.0 / 32767))), mone);
+				__m128 z = _mm_sub_ps (_mm_sub_ps (one, abs_ps (u)), abs_ps (w));
+				__m128 t = _mm_max_ps (neg_ps (z), zero);
+				u = _mm_add_ps (u, select_ps (_mm_cmpge_ps (u, zero), neg_ps (t), t));
+				w = _mm_add_ps (w, select_ps (_mm_cmpge_ps (w, zero), neg_ps (t), t));
+				__m128 mi = _mm_div_ps (one, _mm_sqrt_ps (_mm_add_ps (_mm_add_ps (_mm_mul_ps (u, u), _mm_mul_ps (w, w)), _mm_mul_ps (z, z))));
+				store_xyz4 (p, _mm_mul_ps (u, mi), _mm_mul_ps (w, mi), _mm_mul_ps (z, mi)); }
+			for (; i < n; ++i) out[i] = UnpackOct<float> (in[i]); }
+#endif
+
+#ifdef VECTOR3_HAS_F16C
+		// Twelve half floats (four vectors, 24 bytes) per step.
+		//
+		inline void pack (Vector3T<float> const* v, size_t n, Half3* out) {
+			float const* p = &v[0].x;
+			char* o = reinterpret_cast<char*> (out);
+			size_t i = 0;
+			for (; i + 4 <= n; i += 4, p += 12, o += 24) {
+				_mm_storel_epi64 (reinterpret_cast<__m128i*> (o), _mm_cvtps_ph (_mm_loadu_ps (p), _MM_FROUND_TO_NEAREST_INT));
+				_mm_storel_epi64 (reinterpret_cast<__m128i*> (o + 8), _mm_cvtps_ph (_mm_loadu_ps (p + 4), _MM_FROUND_TO_NEAREST_INT));
+				_mm_storel_epi64 (reinterpret_cast<__m128i*> (o + 16), _mm_cvtps_ph (_mm_loadu_ps (p + 8), _MM_FROUND_TO_NEAREST_INT)); }
+			for (; i < n; ++i) out[i] = PackHalf (v[i]); }
+
+		inline void unpack (Half3 const* in, size_t n, Vector3T<float>* out) {
+			char const* s = reinterpret_cast<char const*> (in);
+			float* p = &out[0].x;
+			size_t i = 0;
+			for (; i + 4 <= n; i += 4, s += 24, p += 12) {
+				_mm_storeu_ps (p, _mm_cvtph_ps (_mm_loadl_epi64 (reinterpret_cast<__m128i const*> (s))));
+				_mm_storeu_ps (p + 4, _mm_cvtph_ps (_mm_loadl_epi64 (reinterpret_cast<__m128i const*> (s + 8))));
+				_mm_storeu_ps (p + 8, _mm_cvtph_ps (_mm_loadl_epi64 (reinterpret_cast<__m128i const*> (s + 16)))); }
+			for (; i < n; ++i) out[i] = UnpackHalf<float> (in[i]); }
+#endif
+	}
+
+	// Fixed point within the quantizer's box.
+	//
+	template <class T> inline
+	void Pack (Vector3T<T> const* v, size_t n, QuantizerT<T> const& q, Fixed16x3* out, Policy const& p = Policy ()) {
+		For (n, p, [=, &q] (size_t b, size_t e) {detail::pack (v + b, e - b, q, out + b);}); }
+
+	template <class T> inline
+	void Unpack (Fixed16x3 const* in, size_t n, QuantizerT<T> const& q, Vector3T<T>* out, Policy const& p = Policy ()) {
+		For (n, p, [=, &q] (size_t b, size_t e) {detail::unpack (in + b, e - b, q, out + b);}); }
+
+	// Octahedral unit vectors.
+	//
+	template <class T> inline
+	void Pack (Vector3T<T> const* v, size_t n, Oct32* out, Policy const& p = Policy ()) {
+		For (n, p, [=] (size_t b, size_t e) {detail::pack (v + b, e - b, out + b);}); }
+
+	template <class T> inline
+	void Unpack (Oct32 const* in, size_t n, Vector3T<T>* out, Policy const& p = Policy ()) {
+		For (n, p, [=] (size_t b, size_t e) {detail::unpack (in + b, e - b, out + b);}); }
+
+	// Half floats.
+	//
+	template <class T> inline
+	void Pack (Vector3T<T> const* v, size_t n, Half3* out, Policy const& p = Policy ()) {
+		For (n, p, [=] (size_t b, size_t e) {detail::pack (v + b, e - b, out + b);}); }
+
+	template <class T> inline
+	void Unpack (Half3 const* in, size_t n, Vector3T<T>* out, Policy const& p = Policy ()) {
+		For (n, p, [=] (size_t b, size_t e) {detail::unpack (in + b, e - b, out + b);}); }
+}
+}
+
+#endif // VECTOR3_PACKED_H
@@ -0,0 +1,136 @@
+#ifndef VECTOR3_REDUCE_H
+#define VECTOR3_REDUCE_H
+
+#include <cstddef> // size_t
+#include <limits>
+#include <new>     // placement new
+#include <utility> // std::pair
+#include <vector>
+
+#include "Vector3.h"
+#include "Box3.h"
+#include "Vector3Batch.h"
+#include "Arena.h"
+
+// ************************************************************************************
+// Vec namespace - Reductions over arrays of Vector3T.
+//
+// Sums are pairwise: leaves of ReduceBlock vectors are added with four
+// independent accumulators (one SIMD lane group each) and the leaves are
+// combined as a balanced tree, so the rounding error grows with log(n)
+// instead of n. A parallel Policy reduces fixed chunks of Policy::chunk
+// vectors and combines them the same way, so the result only depends on
+// the chunk size, never on the number of threads. The per-chunk partial
+// results come from the scratch Arena when one is given, otherwise from the
+// heap.
+//
+// ************************************************************************************
+//
+namespace Vec
+{
+	// Leaf size of the pairwise sum.
+	//
+	const size_t ReduceBlock = 256;
+
+	namespace detail
+	{
+		template <class T> inline
+		Vector3T<T> sum_leaf (Vector3T<T> const* v, size_t n) {
+			Vector3T<T> a(T(0)), b(T(0)), c(T(0)), d(T(0));
+			size_t i = 0;
+			for (; i + 4 <= n; i += 4) {a += v[i]; b += v[i+1]; c += v[i+2]; d += v[i+3];}
+			for (; i < n; ++i) a += v[i];
+			a += b; c += d; a += c;
+			return a; }
+
+		template <class T> inline
+		Vector3T<T> sum_pairwise (Vector3T<T> const* v, size_t n) {
+			if (n <= ReduceBlock) return sum_leaf (v, n);
+			size_t h = n / 2;
+			Vector3T<T> s = sum_pairwise (v, h);
+			s += sum_pairwise (v + h, n - h);
+			return s; }
+
+		// Runs leaf(begin, end) over fixed chunks and holds the partial
+		// results in chunk order; scratch memory is released on destruction.
+		//
+		template <class R>
+		struct Partials
+		{
+			std::vector<R> own;
+			Arena* scratch;
+			Arena::Marker mark;
+			R* data;
+			size_t size;
+
+			template <class F>
+			Partials (size_t n, batch::Policy const& p, Arena* scratch, F const& leaf) : scratch(scratch) {
+				size_t const chunk = p.chunk ? p.chunk : batch::DefaultChunk;
+				size = (n + chunk - 1) / chunk;
+				if (scratch) {mark = scratch->Mark (); data = scratch->Allocate<R> (size);}
+				else {own.resize (size); data = own.data ();}
+				R* const out = data;
+				batch::Policy each (p); each.chunk = 1;
+				batch::For (size, each, [&] (size_t cb, size_t ce) {
+					for (size_t c = cb; c < ce; ++c) {
+						size_t b = c * chunk;
+						new (out + c) R (leaf (b, (n - b < chunk) ? n : b + chunk)); } }); }
+			~Partials () {if (scratch) scratch->Release (mark);}
+		};
+	}
+
+	// The sum of n vectors.
+	//
+	template <class T> inline
+	Vector3T<T> Sum (Vector3T<T> const* v, size_t n, batch::Policy const& p = batch::Policy (), Arena* scratch = 0) {
+		VECTOR3_TIME (OpSum, n);
+		if (!p.pool && !p.parUnseq) return detail::sum_pairwise (v, n);
+		detail::Partials<Vector3T<T> > partial (n, p, scratch, [=] (size_t b, size_t e) {
+			return detail::sum_pairwise (v + b, e - b); });
+		return detail::sum_pairwise (partial.data, partial.size); }
+
+	// The centroid (mean) of n vectors; the zero vector when n is 0.
+	//
+	template <class T> inline
+	Vector3T<T> Centroid (Vector3T<T> const* v, size_t n, batch::Policy const& p = batch::Policy (), Arena* scratch = 0) {
+		if (n == 0) return Zero<T> ();
+		return Sum (v, n, p, scratch) / T(n); }
+
+	// The axis-aligned bounding box of n vectors; Box3T::Empty() when n is 0.
+	//
+	template <class T> inline
+	Box3T<T> Bounds (Vector3T<T> const* v, size_t n, batch::Policy const& p = batch::Policy (), Arena* scratch = 0) {
+		VECTOR3_TIME (OpBounds, n);
+		auto leaf = [=] (size_t b, size_t e) {
+			Box3T<T> box = Box3T<T>::Empty ();
+			for (size_t i = b; i < e; ++i) box.Extend (v[i]);
+			return box; };
+		if (!p.pool && !p.parUnseq) return leaf (0, n);
+		detail::Partials<Box3T<T> > partial (n, p, scratch, leaf);
+		Box3T<T> box = Box3T<T>::Empty ();
+		for (size_t i = 0; i < partial.size; ++i) box.Extend (partial.data[i]);
+		return box; }
+
+	// The smallest and largest LengthSq of n vectors (first is the minimum);
+	// (max, 0) when n is 0.
+	//
+	template <class T> inline
+	std::pair<T, T> MinMaxLengthSq (Vector3T<T> const* v, size_t n, batch::Policy const& p = batch::Policy (), Arena* scratch = 0) {
+		VECTOR3_TIME (OpMinMaxLengthSq, n);
+		typedef std::pair<T, T> Range;
+		auto leaf = [=] (size_t b, size_t e) {
+			T lo = std::numeric_limits<T>::max (), hi = T(0);
+			for (size_t i = b; i < e; ++i) {
+				T m = v[i].LengthSq ();
+				lo = m < lo ? m : lo; hi = m > hi ? m : hi; }
+			return Range (lo, hi); };
+		if (!p.pool && !p.parUnseq) return leaf (0, n);
+		detail::Partials<Range> partial (n, p, scratch, leaf);
+		Range r (std::numeric_limits<T>::max (), T(0));
+		for (size_t i = 0; i < partial.size; ++i) {
+			r.first = partial.data[i].first < r.first ? partial.data[i].first : r.first;
+			r.second = partial.data[i].second > r.second ? partial.data[i].second : r.second; }
+		return r; }
+}
+
+#endif // VECTOR3_REDUCE_H
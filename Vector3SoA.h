@@ -0,0 +1,341 @@
+#ifndef VECTOR3_SOA_H
+#define VECTOR3_SOA_H
+
+#include <cstddef> // size_t
+#include <cstdlib> // malloc, free
+#include <cstring> // memcpy
+#include <cassert>
+#include <new>     // std::bad_alloc
+#include <limits>
+
+#include "Vector3.h"
+
+// Restrict and alignment hints so the batch loops below vectorize.
+//
+#if defined(__GNUC__) || defined(__clang__)
+	#define VEC_RESTRICT __restrict__
+	#define VEC_ASSUME_ALIGNED(p, a) ((decltype(p)) __builtin_assume_aligned ((p), (a)))
+#elif defined(_MSC_VER)
+	#define VEC_RESTRICT __restrict
+	#define VEC_ASSUME_ALIGNED(p, a) (p)
+#else
+	#define VEC_RESTRICT
+	#define VEC_ASSUME_ALIGNED(p, a) (p)
+#endif
+
+
+// ************************************************************************************
+// Vec namespace - Aligned memory helpers.
+//
+//
+// ************************************************************************************
+//
+namespace Vec
+{
+	// Alignment of every Vector3SoA stream (one cache line).
+	//
+	const size_t SoAAlignment = 64;
+
+	// Allocates n bytes aligned to a power of two. The original pointer
+	// is stored just before the returned block.
+	//
+	inline void* AlignedAlloc (size_t n, size_t align) {
+		void* raw = std::malloc (n + align + sizeof (void*));
+		if (!raw) throw std::bad_alloc ();
+		size_t p = (reinterpret_cast<size_t> (raw) + sizeof (void*) + align - 1) & ~(align - 1);
+		reinterpret_cast<void**> (p)[-1] = raw;
+		return reinterpret_cast<void*> (p); }
+
+	inline void AlignedFree (void* p) {
+		if (p) std::free (reinterpret_cast<void**> (p)[-1]); }
+}
+
+
+// ************************************************************************************
+// Vector3SoAT structure - Structure-of-arrays container of Vector3T<T>.
+//
+// The x, y and z components live in three separate streams, each aligned to
+// SoAAlignment, so the batch functions below run one SIMD lane per element.
+//
+// ************************************************************************************
+//
+namespace Vec
+{
+	template <class T>
+	class Vector3SoAT
+	{
+	public:
+		typedef T Scalar;
+		typedef Vector3T<T> Vector3;
+
+		// Constructors.
+		//
+		Vector3SoAT () : data(0), size(0), capacity(0) {}
+		explicit Vector3SoAT (size_t n) : data(0), size(0), capacity(0) {Resize (n);}
+		Vector3SoAT (Vector3 const* v, size_t n) : data(0), size(0), capacity(0) {FromAoS (v, n);}
+		Vector3SoAT (Vector3SoAT const& s) : data(0), size(0), capacity(0) {*this = s;}
+		~Vector3SoAT () {AlignedFree (data);}
+
+		Vector3SoAT& operator= (Vector3SoAT const& s) {
+			if (this != &s) {
+				Resize (s.size);
+				if (size) {
+					std::memcpy (X (), s.X (), size * sizeof (Scalar));
+					std::memcpy (Y (), s.Y (), size * sizeof (Scalar));
+					std::memcpy (Z (), s.Z (), size * sizeof (Scalar)); } }
+			return *this; }
+
+		// Number of vectors.
+		//
+		size_t Size () const {return size;}
+		bool Empty () const {return size == 0;}
+
+		// Resizes the container. Existing elements are kept, new ones are
+		// left uninitialized just like Vector3's default constructor.
+		//
+		void Resize (size_t n) {
+			if (n > capacity) Reserve (n);
+			size = n; }
+
+		// Grows the streams to hold at least n vectors.
+		//
+		void Reserve (size_t n) {
+			if (n <= capacity) return;
+			size_t const lane = SoAAlignment / sizeof (Scalar);
+			size_t cap = (n + lane - 1) / lane * lane;
+			Scalar* d = static_cast<Scalar*> (AlignedAlloc (3 * cap * sizeof (Scalar), SoAAlignment));
+			if (size) {
+				std::memcpy (d, X (), size * sizeof (Scalar));
+				std::memcpy (d + cap, Y (), size * sizeof (Scalar));
+				std::memcpy (d + 2*cap, Z (), size * sizeof (Scalar)); }
+			AlignedFree (data);
+			data = d;
+			capacity = cap; }
+
+		// Component streams.
+		//
+		Scalar* X () {return data;}
+		Scalar* Y () {return data + capacity;}
+		Scalar* Z () {return data + 2*capacity;}
+		Scalar const* X () const {return data;}
+		Scalar const* Y () const {return data + capacity;}
+		Scalar const* Z () const {return data + 2*capacity;}
+
+		// Element access.
+		//
+		Vector3 Get (size_t i) const {return Vector3 (X ()[i], Y ()[i], Z ()[i]);}
+		void Set (size_t i, Vector3 const& v) {X ()[i] = v.x; Y ()[i] = v.y; Z ()[i] = v.z;}
+
+		// Conversion from and to an array of Vector3.
+		//
+		void FromAoS (Vector3 const* v, size_t n) {
+			Resize (n);
+			Scalar* VEC_RESTRICT x = X (); Scalar* VEC_RESTRICT y = Y (); Scalar* VEC_RESTRICT z = Z ();
+			for (size_t i = 0; i < n; ++i) {x[i] = v[i].x; y[i] = v[i].y; z[i] = v[i].z;} }
+
+		void ToAoS (Vector3* v) const {
+			Scalar const* VEC_RESTRICT x = X (); Scalar const* VEC_RESTRICT y = Y (); Scalar const* VEC_RESTRICT z = Z ();
+			for (size_t i = 0; i < size; ++i) {v[i].x = x[i]; v[i].y = y[i]; v[i].z = z[i];} }
+
+		// Converts every vector to the zero vector.
+		//
+		void Zero () {
+			if (!size) return;
+			std::memset (X (), 0, size * sizeof (Scalar));
+			std::memset (Y (), 0, size * sizeof (Scalar));
+			std::memset (Z (), 0, size * sizeof (Scalar)); }
+
+	private:
+		Scalar* data;
+		size_t size, capacity;
+	};
+
+	// The FLOAT_TYPE container.
+	//
+	typedef Vector3SoAT<Scalar> Vector3SoA;
+	typedef Vector3SoAT<float> Vector3SoAf;
+	typedef Vector3SoAT<double> Vector3SoAd;
+}
+
+
+// ************************************************************************************
+// Vec namespace - Batch versions of the external vector functions.
+//
+// Every function works element-wise over Vector3SoAT containers of equal size.
+// Scalar results are written to caller supplied arrays of Size() elements,
+// vector results to a container that is resized to match (and may alias an
+// input).
+//
+// ************************************************************************************
+//
+namespace Vec
+{
+	// Declares aligned, non-aliasing stream pointers px, py, pz of a container
+	// whose scalar type is T.
+	//
+	#define VEC_SOA_STREAMS(p, s, CONST) \
+		T CONST* VEC_RESTRICT p##x = VEC_ASSUME_ALIGNED ((s).X (), Vec::SoAAlignment); \
+		T CONST* VEC_RESTRICT p##y = VEC_ASSUME_ALIGNED ((s).Y (), Vec::SoAAlignment); \
+		T CONST* VEC_RESTRICT p##z = VEC_ASSUME_ALIGNED ((s).Z (), Vec::SoAAlignment)
+
+	// Magnitude squared of every vector.
+	//
+	template <class T> inline void MagSq (Vector3SoAT<T> const& v, T* VEC_RESTRICT out) {
+		VEC_SOA_STREAMS (a, v, const); size_t const n = v.Size ();
+		for (size_t i = 0; i < n; ++i) out[i] = ax[i]*ax[i] + ay[i]*ay[i] + az[i]*az[i]; }
+
+	// Magnitude of every vector.
+	//
+	template <class T> inline void Mag (Vector3SoAT<T> const& v, T* VEC_RESTRICT out) {
+		VEC_SOA_STREAMS (a, v, const); size_t const n = v.Size ();
+		for (size_t i = 0; i < n; ++i) out[i] = std::sqrt (ax[i]*ax[i] + ay[i]*ay[i] + az[i]*az[i]); }
+
+	// Distance squared between corresponding vectors.
+	//
+	template <class T> inline void DistanceSq (Vector3SoAT<T> const& l, Vector3SoAT<T> const& r, T* VEC_RESTRICT out) {
+		assert (l.Size () == r.Size ());
+		VEC_SOA_STREAMS (a, l, const); VEC_SOA_STREAMS (b, r, const); size_t const n = l.Size ();
+		for (size_t i = 0; i < n; ++i) {
+			T dx = ax[i]-bx[i], dy = ay[i]-by[i], dz = az[i]-bz[i];
+			out[i] = dx*dx + dy*dy + dz*dz; } }
+
+	// Distance between corresponding vectors.
+	//
+	template <class T> inline void Distance (Vector3SoAT<T> const& l, Vector3SoAT<T> const& r, T* VEC_RESTRICT out) {
+		assert (l.Size () == r.Size ());
+		VEC_SOA_STREAMS (a, l, const); VEC_SOA_STREAMS (b, r, const); size_t const n = l.Size ();
+		for (size_t i = 0; i < n; ++i) {
+			T dx = ax[i]-bx[i], dy = ay[i]-by[i], dz = az[i]-bz[i];
+			out[i] = std::sqrt (dx*dx + dy*dy + dz*dz); } }
+
+	// The dot product of corresponding vectors.
+	//
+	template <class T> inline void Dot (Vector3SoAT<T> const& l, Vector3SoAT<T> const& r, T* VEC_RESTRICT out) {
+		assert (l.Size () == r.Size ());
+		VEC_SOA_STREAMS (a, l, const); VEC_SOA_STREAMS (b, r, const); size_t const n = l.Size ();
+		for (size_t i = 0; i < n; ++i) out[i] = ax[i]*bx[i] + ay[i]*by[i] + az[i]*bz[i]; }
+
+	// The cross product of corresponding vectors.
+	//
+	template <class T> inline void Cross (Vector3SoAT<T> const& l, Vector3SoAT<T> const& r, Vector3SoAT<T>& out) {
+		assert (l.Size () == r.Size ());
+		if (&out == &l || &out == &r) {Vector3SoAT<T> t; Cross (l, r, t); out = t; return;}
+		out.Resize (l.Size ());
+		VEC_SOA_STREAMS (a, l, const); VEC_SOA_STREAMS (b, r, const); VEC_SOA_STREAMS (o, out, );
+		size_t const n = l.Size ();
+		for (size_t i = 0; i < n; ++i) {
+			ox[i] = ay[i]*bz[i] - az[i]*by[i];
+			oy[i] = az[i]*bx[i] - ax[i]*bz[i];
+			oz[i] = ax[i]*by[i] - ay[i]*bx[i]; } }
+
+	// Normalizes every vector in place; the previous lengths are written
+	// to lengths when it is not null.
+	//
+	template <class T> inline void Normalize (Vector3SoAT<T>& v, T* VEC_RESTRICT lengths = 0) {
+		VEC_SOA_STREAMS (o, v, ); size_t const n = v.Size ();
+		if (lengths) {
+			for (size_t i = 0; i < n; ++i) {
+				T m = std::sqrt (ox[i]*ox[i] + oy[i]*oy[i] + oz[i]*oz[i]);
+				T mi = T(1)/m;
+				ox[i]*=mi; oy[i]*=mi; oz[i]*=mi; lengths[i] = m; } }
+		else {
+			for (size_t i = 0; i < n; ++i) {
+				T mi = T(1)/std::sqrt (ox[i]*ox[i] + oy[i]*oy[i] + oz[i]*oz[i]);
+				ox[i]*=mi; oy[i]*=mi; oz[i]*=mi; } } }
+
+	// Normalized copies of every vector.
+	//
+	template <class T> inline void Unit (Vector3SoAT<T> const& v, Vector3SoAT<T>& out) {
+		if (&out != &v) out = v;
+		Normalize (out); }
+
+	namespace detail
+	{
+		// Reciprocal square root estimates of n values (see Vec::rsqrt_estimate).
+		//
+		inline void rsqrt_estimate (float const* x, float* y, size_t n) {
+			size_t i = 0;
+#ifdef VECTOR3_HAS_SSE2
+			for (; i + 4 <= n; i += 4) _mm_storeu_ps (y + i, _mm_rsqrt_ps (_mm_loadu_ps (x + i)));
+#endif
+			for (; i < n; ++i) y[i] = Vec::rsqrt_estimate (x[i]); }
+
+		inline void rsqrt_estimate (double const* x, double* y, size_t n) {
+			size_t i = 0;
+#ifdef VECTOR3_HAS_SSE2
+			for (; i + 4 <= n; i += 4) {
+				__m128 f = _mm_movelh_ps (_mm_cvtpd_ps (_mm_loadu_pd (x + i)), _mm_cvtpd_ps (_mm_loadu_pd (x + i + 2)));
+				f = _mm_rsqrt_ps (f);
+				_mm_storeu_pd (y + i, _mm_cvtps_pd (f));
+				_mm_storeu_pd (y + i + 2, _mm_cvtps_pd (_mm_movehl_ps (f, f))); }
+#endif
+			for (; i < n; ++i) y[i] = Vec::rsqrt_estimate (x[i]); }
+	}
+
+	// Approximately normalizes every vector in place with Steps Newton
+	// iterations (error bounds as Vec::UnitFast); the approximate previous
+	// lengths are written to lengths when it is not null.
+	//
+	template <int Steps = 1, class T> inline void NormalizeFast (Vector3SoAT<T>& v, T* VEC_RESTRICT lengths = 0) {
+		VEC_SOA_STREAMS (o, v, ); size_t const n = v.Size ();
+		size_t const block = 256;
+		T m2[block], r[block];
+		for (size_t b = 0; b < n; b += block) {
+			size_t const m = (n - b < block) ? n - b : block;
+			T* VEC_RESTRICT bx = ox + b; T* VEC_RESTRICT by = oy + b; T* VEC_RESTRICT bz = oz + b;
+			for (size_t i = 0; i < m; ++i) m2[i] = bx[i]*bx[i] + by[i]*by[i] + bz[i]*bz[i];
+			detail::rsqrt_estimate (m2, r, m);
+			for (int s = 0; s < Steps; ++s)
+				for (size_t i = 0; i < m; ++i) r[i] = rsqrt_step (m2[i], r[i]);
+			for (size_t i = 0; i < m; ++i) {bx[i]*=r[i]; by[i]*=r[i]; bz[i]*=r[i];}
+			if (lengths)
+				for (size_t i = 0; i < m; ++i) lengths[b + i] = m2[i]*r[i]; } }
+
+	// Approximately normalized copies of every vector.
+	//
+	template <int Steps = 1, class T> inline void UnitFast (Vector3SoAT<T> const& v, Vector3SoAT<T>& out) {
+		if (&out != &v) out = v;
+		NormalizeFast<Steps> (out); }
+
+	// Normalizes every vector in place, replacing the ones that cannot be
+	// normalized with fallback (see Vector3T::NormalizeSafe). The previous
+	// lengths are written to lengths when it is not null.
+	//
+	template <class T> inline void NormalizeSafe (Vector3SoAT<T>& v, Vector3T<T> const& fallback, T* VEC_RESTRICT lengths = 0) {
+		VEC_SOA_STREAMS (o, v, ); size_t const n = v.Size ();
+		T const fx = fallback.x, fy = fallback.y, fz = fallback.z;
+		T const lo = std::numeric_limits<T>::min (), hi = std::numeric_limits<T>::max ();
+		for (size_t i = 0; i < n; ++i) {
+			T m2 = ox[i]*ox[i] + oy[i]*oy[i] + oz[i]*oz[i]; T m = std::sqrt (m2);
+			bool ok = (m2 >= lo) & (m2 <= hi);
+			T mi = T(1)/(ok ? m : T(1));
+			ox[i] = ok ? ox[i]*mi : fx; oy[i] = ok ? oy[i]*mi : fy; oz[i] = ok ? oz[i]*mi : fz;
+			if (lengths) lengths[i] = m; } }
+
+	// Normalized copies of every vector, or fallback where that is impossible.
+	//
+	template <class T> inline void UnitOr (Vector3SoAT<T> const& v, Vector3T<T> const& fallback, Vector3SoAT<T>& out) {
+		if (&out != &v) out = v;
+		NormalizeSafe (out, fallback); }
+
+	// y += a*x for every pair of corresponding vectors, with fused multiply-adds.
+	//
+	template <class T> inline void Axpy (T a, Vector3SoAT<T> const& x, Vector3SoAT<T>& y) {
+		assert (x.Size () == y.Size ());
+		VEC_SOA_STREAMS (a, x, const); VEC_SOA_STREAMS (o, y, ); size_t const n = y.Size ();
+		for (size_t i = 0; i < n; ++i) {
+			ox[i] = std::fma (a, ax[i], ox[i]); oy[i] = std::fma (a, ay[i], oy[i]); oz[i] = std::fma (a, az[i], oz[i]); } }
+
+	// The unsigned area of the parallelograms formed by corresponding vectors.
+	//
+	template <class T> inline void Area (Vector3SoAT<T> const& l, Vector3SoAT<T> const& r, T* VEC_RESTRICT out) {
+		assert (l.Size () == r.Size ());
+		VEC_SOA_STREAMS (a, l, const); VEC_SOA_STREAMS (b, r, const); size_t const n = l.Size ();
+		for (size_t i = 0; i < n; ++i) {
+			T cx = ay[i]*bz[i] - az[i]*by[i];
+			T cy = az[i]*bx[i] - ax[i]*bz[i];
+			T cz = ax[i]*by[i] - ay[i]*bx[i];
+			out[i] = std::sqrt (cx*cx + cy*cy + cz*cz); } }
+}
+
+#endif // VECTOR3_SOA_H
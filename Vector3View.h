@@ -0,0 +1,498 @@
+#ifndef VECTOR3_VIEW_H
+#define VECTOR3_VIEW_H
+
+#include <cstddef> // size_t, ptrdiff_t
+#include <cstdint>
+#include <cassert>
+#include <iterator>
+#include <type_traits>
+
+#include "Vector3.h"
+#include "Vector3Batch.h"
+#include "Transform.h"
+#include "Vector3Reduce.h"
+#include "SpatialSort.h"
+
+#if __cplusplus >= 202002L && defined(__has_include)
+	#if __has_include(<span>)
+		#include <span>
+		#define VECTOR3_HAS_SPAN
+	#endif
+#endif
+
+#ifdef VECTOR3_USE_EIGEN
+	#include <Eigen/Core>
+#endif
+
+#ifdef VECTOR3_USE_GLM
+	#include <glm/vec3.hpp>
+#endif
+
+// ************************************************************************************
+// Vector3ViewT class - Zero-copy strided view of Vector3T elements in a scalar buffer.
+//
+// Element i is the three scalars at data + i*stride, stride counted in
+// scalars and at least 3, read and written in place as a Vector3T: the
+// standard-layout asserts in Vector3.h guarantee the triple has Vector3T's
+// layout. A view with stride 3 is an ordinary Vector3T array. T may be
+// const for read-only views; a view converts to its const version. The
+// view never owns its buffer.
+//
+// With VECTOR3_USE_EIGEN defined, ToEigen maps a view as an
+// Eigen::Matrix<T, 3, Dynamic> with an outer stride and View takes such
+// matrices; with VECTOR3_USE_GLM, View takes glm::vec<3, T> arrays and
+// ToGlm returns one for a contiguous view. Under C++20 views convert from
+// and to std::span of Vector3T.
+//
+// Eigen and scalar buffers are read through the scalars, which may alias
+// Vector3T. glm::vec and Vector3T are unrelated types to the optimizer:
+// code that reaches the same vectors through both in one function must be
+// built with -fno-strict-aliasing or its compiler's equivalent.
+//
+// ************************************************************************************
+//
+namespace Vec
+{
+	template <class T>
+	class Vector3ViewT
+	{
+	public:
+		typedef typename std::remove_const<T>::type Scalar;
+		typedef typename std::conditional<std::is_const<T>::value, Vector3T<Scalar> const, Vector3T<Scalar> >::type Element;
+
+		// Random-access iterator over the elements.
+		//
+		class Iterator
+		{
+		public:
+			typedef std::random_access_iterator_tag iterator_category;
+			typedef Vector3T<Scalar> value_type;
+			typedef ptrdiff_t difference_type;
+			typedef Element* pointer;
+			typedef Element& reference;
+
+			Iterator () : p(0), stride(3) {}
+			Iterator (T* p, size_t stride) : p(p), stride(ptrdiff_t (stride)) {}
+
+			reference operator* () const {return *reinterpret_cast<Element*> (p);}
+			pointer operator-> () const {return reinterpret_cast<Element*> (p);}
+			reference operator[] (difference_type i) const {return *reinterpret_cast<Element*> (p + i*stride);}
+
+			Iterator& operator++ () {p += stride; return *this;}
+			Iterator& operator-- () {p -= stride; return *this;}
+			Iterator operator++ (int) {Iterator t (*this); p += stride; return t;}
+			Iterator operator-- (int) {Iterator t (*this); p -= stride; return t;}
+			Iterator& operator+= (difference_type i) {p += i*stride; return *this;}
+			Iterator& operator-= (difference_type i) {p -= i*stride; return *this;}
+			Iterator operator+ (difference_type i) const {return Iterator (*this) += i;}
+			Iterator operator- (difference_type i) const {return Iterator (*this) -= i;}
+			friend Iterator operator+ (difference_type i, Iterator const& it) {return it + i;}
+			difference_type operator- (Iterator const& it) const {return (p - it.p) / stride;}
+
+			bool operator== (Iterator const& it) const {return p == it.p;}
+			bool operator!= (Iterator const& it) const {return p != it.p;}
+			bool operator< (Iterator const& it) const {return p < it.p;}
+			bool operator> (Iterator const& it) const {return p > it.p;}
+			bool operator<= (Iterator const& it) const {return p <= it.p;}
+			bool operator>= (Iterator const& it) const {return p >= it.p;}
+
+		private:
+			T* p;
+			ptrdiff_t stride;
+		};
+
+		// Constructors.
+		//
+		Vector3ViewT () : data(0), size(0), stride(3) {}
+		Vector3ViewT (T* data, size_t n, size_t stride = 3) : data(data), size(n), stride(stride) {assert (stride >= 3);}
+		Vector3ViewT (Element* v, size_t n) : data(&v->x), size(n), stride(3) {}
+#ifdef VECTOR3_HAS_SPAN
+		Vector3ViewT (std::span<Element> s) : data(&s.data ()->x), size(s.size ()), stride(3) {}
+#endif
+
+		// The read-only view.
+		//
+		operator Vector3ViewT<Scalar const> () const {return Vector3ViewT<Scalar const> (data, size, stride);}
+
+		// Shape.
+		//
+		size_t Size () const {return size;}
+		bool Empty () const {return size == 0;}
+		size_t Stride () const {return stride;}
+		bool Contiguous () const {return stride == 3;}
+
+		// The first scalar, and the elements as a Vector3T array when
+		// Contiguous.
+		//
+		T* Data () const {return data;}
+		Element* Vectors () const {assert (Contiguous ()); return reinterpret_cast<Element*> (data);}
+#ifdef VECTOR3_HAS_SPAN
+		std::span<Element> Span () const {return std::span<Element> (Vectors (), size);}
+#endif
+
+		// Element access.
+		//
+		Element& operator[] (size_t i) const {return *reinterpret_cast<Element*> (data + i*stride);}
+		Iterator begin () const {return Iterator (data, stride);}
+		Iterator end () const {return Iterator (data + size*stride, stride);}
+
+		// Elements [b, e).
+		//
+		Vector3ViewT Sub (size_t b, size_t e) const {assert (b <= e && e <= size); return Vector3ViewT (data + b*stride, e - b, stride);}
+
+	private:
+		T* data;
+		size_t size, stride;
+	};
+
+	// The FLOAT_TYPE view.
+	//
+	typedef Vector3ViewT<Scalar> Vector3View;
+	typedef Vector3ViewT<Scalar const> Vector3ConstView;
+
+	// Views of n vectors of a scalar buffer, stride scalars apart, and of a
+	// Vector3T array.
+	//
+	template <class T> inline
+	Vector3ViewT<T> View (T* data, size_t n, size_t stride = 3) {return Vector3ViewT<T> (data, n, stride);}
+
+	template <class T> inline
+	Vector3ViewT<T> View (Vector3T<T>* v, size_t n) {return Vector3ViewT<T> (v, n);}
+
+	template <class T> inline
+	Vector3ViewT<T const> View (Vector3T<T> const* v, size_t n) {return Vector3ViewT<T const> (v, n);}
+
+#ifdef VECTOR3_USE_EIGEN
+	// An Eigen map of the 3 x n matrix whose columns are the elements.
+	//
+	template <class T> inline
+	Eigen::Map<typename std::conditional<std::is_const<T>::value,
+		Eigen::Matrix<typename std::remove_const<T>::type, 3, Eigen::Dynamic> const,
+		Eigen::Matrix<typename std::remove_const<T>::type, 3, Eigen::Dynamic> >::type, Eigen::Unaligned, Eigen::OuterStride<> >
+	ToEigen (Vector3ViewT<T> const& v) {
+		typedef Eigen::Matrix<typename std::remove_const<T>::type, 3, Eigen::Dynamic> M;
+		typedef typename std::conditional<std::is_const<T>::value, M const, M>::type C;
+		return Eigen::Map<C, Eigen::Unaligned, Eigen::OuterStride<> > (v.Data (), 3, Eigen::Index (v.Size ()), Eigen::OuterStride<> (Eigen::Index (v.Stride ())));}
+
+	// The columns of a 3 x n matrix.
+	//
+	template <class T> inline
+	Vector3ViewT<T> View (Eigen::Matrix<T, 3, Eigen::Dynamic>& m) {return Vector3ViewT<T> (m.data (), size_t (m.cols ()));}
+
+	template <class T> inline
+	Vector3ViewT<T const> View (Eigen::Matrix<T, 3, Eigen::Dynamic> const& m) {return Vector3ViewT<T const> (m.data (), size_t (m.cols ()));}
+#endif
+
+#ifdef VECTOR3_USE_GLM
+	// Views of glm vector arrays, and glm vectors of a contiguous view.
+	//
+	template <class T, glm::qualifier Q> inline
+	Vector3ViewT<T> View (glm::vec<3, T, Q>* v, size_t n) {
+		static_assert (sizeof (glm::vec<3, T, Q>) == 3 * sizeof (T), "Padded glm vectors");
+		return Vector3ViewT<T> (&v->x, n); }
+
+	template <class T, glm::qualifier Q> inline
+	Vector3ViewT<T const> View (glm::vec<3, T, Q> const* v, size_t n) {
+		static_assert (sizeof (glm::vec<3, T, Q>) == 3 * sizeof (T), "Padded glm vectors");
+		return Vector3ViewT<T const> (&v->x, n); }
+
+	template <class T> inline
+	typename std::conditional<std::is_const<T>::value, glm::vec<3, typename std::remove_const<T>::type> const, glm::vec<3, T> >::type*
+	ToGlm (Vector3ViewT<T> const& v) {
+		typedef typename std::conditional<std::is_const<T>::value, glm::vec<3, typename std::remove_const<T>::type> const, glm::vec<3, T> >::type G;
+		static_assert (sizeof (G) == 3 * sizeof (T), "Padded glm vectors");
+		assert (v.Contiguous ());
+		return reinterpret_cast<G*> (v.Data ()); }
+#endif
+}
+
+
+// ************************************************************************************
+// Vec::batch namespace - Batch functions over views.
+//
+// Every batch function, transform and reduction, and the spatial key,
+// Permute and SpatialSort functions, also take views in place of their
+// vector arrays; n is the size of the first view and every other view must
+// be at least as long. Contiguous views run the array kernels, SIMD paths
+// included; strided ones the same per-element code through the stride.
+// SortByKey takes no vectors and has no view form.
+//
+// ************************************************************************************
+//
+namespace Vec
+{
+namespace batch
+{
+	template <class T> inline
+	void Normalize (Vector3ViewT<T> const& v, T* lengths = 0, Policy const& p = Policy ()) {
+		if (v.Contiguous ()) {Normalize (v.Vectors (), v.Size (), lengths, p); return;}
+		VECTOR3_TIME (OpBatchNormalize, v.Size ());
+		For (v.Size (), p, [=] (size_t b, size_t e) {
+			if (lengths) for (size_t i = b; i < e; ++i) lengths[i] = v[i].Normalize ();
+			else for (size_t i = b; i < e; ++i) v[i].Normalize (); }); }
+
+	template <class T> inline
+	void Normalize (Vector3ViewT<T> const& v, Policy const& p) {Normalize (v, (T*) 0, p);}
+
+	template <class T> inline
+	void NormalizeFast (Vector3ViewT<T> const& v, Policy const& p = Policy ()) {
+		if (v.Contiguous ()) {NormalizeFast (v.Vectors (), v.Size (), p); return;}
+		VECTOR3_TIME (OpBatchNormalizeFast, v.Size ());
+		For (v.Size (), p, [=] (size_t b, size_t e) {
+			for (size_t i = b; i < e; ++i) v[i].NormalizeFast (); }); }
+
+	template <class T> inline
+	void NormalizeSafe (Vector3ViewT<T> const& v, Vector3T<T> const& fallback, Policy const& p = Policy ()) {
+		if (v.Contiguous ()) {NormalizeSafe (v.Vectors (), v.Size (), fallback, p); return;}
+		VECTOR3_TIME (OpBatchNormalizeSafe, v.Size ());
+		For (v.Size (), p, [=] (size_t b, size_t e) {
+			for (size_t i = b; i < e; ++i) v[i].NormalizeSafe (fallback); }); }
+
+	template <class U, class T> inline
+	void Unit (Vector3ViewT<U> const& v, Vector3ViewT<T> const& out, Policy const& p = Policy ()) {
+		static_assert (std::is_same<typename std::remove_const<U>::type, T>::value, "Scalar types differ");
+		assert (out.Size () >= v.Size ());
+		if (v.Contiguous () && out.Contiguous ()) {Unit (v.Vectors (), v.Size (), out.Vectors (), p); return;}
+		VECTOR3_TIME (OpBatchUnit, v.Size ());
+		For (v.Size (), p, [=] (size_t b, size_t e) {
+			for (size_t i = b; i < e; ++i) out[i] = Vec::Unit (v[i]); }); }
+
+	template <class U> inline
+	void ToPoint2D (Vector3ViewT<U> const& v, Point2D* out, Policy const& p = Policy ()) {
+		if (v.Contiguous ()) {ToPoint2D (v.Vectors (), v.Size (), out, p); return;}
+		VECTOR3_TIME (OpBatchToPoint2D, v.Size ());
+		For (v.Size (), p, [=] (size_t b, size_t e) {
+			for (size_t i = b; i < e; ++i) out[i] = Vec::to_point2d (v[i]); }); }
+
+	template <class U, class T> inline
+	void Distance (Vector3ViewT<U> const& v, Vector3T<T> const& point, T* out, Policy const& p = Policy ()) {
+		if (v.Contiguous ()) {Distance (v.Vectors (), v.Size (), point, out, p); return;}
+		VECTOR3_TIME (OpBatchDistance, v.Size ());
+		For (v.Size (), p, [=] (size_t b, size_t e) {
+			for (size_t i = b; i < e; ++i) out[i] = Vec::Distance (v[i], point); }); }
+
+	template <class U, class T> inline
+	void DistanceSq (Vector3ViewT<U> const& v, Vector3T<T> const& point, T* out, Policy const& p = Policy ()) {
+		if (v.Contiguous ()) {DistanceSq (v.Vectors (), v.Size (), point, out, p); return;}
+		VECTOR3_TIME (OpBatchDistanceSq, v.Size ());
+		For (v.Size (), p, [=] (size_t b, size_t e) {
+			for (size_t i = b; i < e; ++i) out[i] = Vec::DistanceSq (v[i], point); }); }
+
+	template <class U, class V, class T> inline
+	void Dot (Vector3ViewT<U> const& l, Vector3ViewT<V> const& r, T* out, Policy const& p = Policy ()) {
+		assert (r.Size () >= l.Size ());
+		if (l.Contiguous () && r.Contiguous ()) {Dot (l.Vectors (), r.Vectors (), l.Size (), out, p); return;}
+		VECTOR3_TIME (OpBatchDot, l.Size ());
+		For (l.Size (), p, [=] (size_t b, size_t e) {
+			for (size_t i = b; i < e; ++i) out[i] = l[i] * r[i]; }); }
+
+	template <class T> inline
+	void Affine (Vector3ViewT<T> const& v, T scale, Vector3T<T> const& offset, Policy const& p = Policy ()) {
+		if (v.Contiguous ()) {Affine (v.Vectors (), v.Size (), scale, offset, p); return;}
+		VECTOR3_TIME (OpBatchAffine, v.Size ());
+		For (v.Size (), p, [=] (size_t b, size_t e) {
+			for (size_t i = b; i < e; ++i) {v[i] *= scale; v[i] += offset;} }); }
+
+	template <class U, class T> inline
+	void Axpy (T a, Vector3ViewT<U> const& x, Vector3ViewT<T> const& y, Policy const& p = Policy ()) {
+		assert (y.Size () >= x.Size ());
+		if (x.Contiguous () && y.Contiguous ()) {Axpy (a, x.Vectors (), y.Vectors (), x.Size (), p); return;}
+		VECTOR3_TIME (OpBatchAxpy, x.Size ());
+		For (x.Size (), p, [=] (size_t b, size_t e) {
+			for (size_t i = b; i < e; ++i) Vec::Axpy (a, x[i], y[i]); }); }
+
+	template <class U, class V, class T> inline
+	void NearlyEqual (Vector3ViewT<U> const& l, Vector3ViewT<V> const& r, T absTol, T relTol, uint8_t* mask, Policy const& p = Policy ()) {
+		assert (r.Size () >= l.Size ());
+		if (l.Contiguous () && r.Contiguous ()) {NearlyEqual (l.Vectors (), r.Vectors (), l.Size (), absTol, relTol, mask, p); return;}
+		VECTOR3_TIME (OpBatchNearlyEqual, l.Size ());
+		For (l.Size (), p, [=] (size_t b, size_t e) {
+			for (size_t i = b; i < e; ++i) mask[i] = uint8_t (Vec::NearlyEqual (l[i], r[i], absTol, relTol)); }); }
+
+	template <class U, class V> inline
+	void UlpEqual (Vector3ViewT<U> const& l, Vector3ViewT<V> const& r, uint64_t maxUlps, uint8_t* mask, Policy const& p = Policy ()) {
+		assert (r.Size () >= l.Size ());
+		if (l.Contiguous () && r.Contiguous ()) {UlpEqual (l.Vectors (), r.Vectors (), l.Size (), maxUlps, mask, p); return;}
+		VECTOR3_TIME (OpBatchUlpEqual, l.Size ());
+		For (l.Size (), p, [=] (size_t b, size_t e) {
+			for (size_t i = b; i < e; ++i) mask[i] = uint8_t (Vec::UlpEqual (l[i], r[i], maxUlps)); }); }
+
+	template <class U, class V, class T> inline
+	size_t Moved (Vector3ViewT<U> const& prev, Vector3ViewT<V> const& cur, T eps, uint8_t* mask, Policy const& p = Policy ()) {
+		assert (cur.Size () >= prev.Size ());
+		if (prev.Contiguous () && cur.Contiguous ()) return Moved (prev.Vectors (), cur.Vectors (), prev.Size (), eps, mask, p);
+		VECTOR3_TIME (OpBatchMoved, prev.Size ());
+		T const e2 = eps * eps;
+		std::atomic<size_t> moved (0);
+		std::atomic<size_t>* m = &moved;
+		For (prev.Size (), p, [=] (size_t b, size_t e) {
+			size_t c = 0;
+			for (size_t i = b; i < e; ++i) {
+				uint8_t f = uint8_t (Vec::DistanceSq (prev[i], cur[i]) > e2);
+				mask[i] = f; c += f; }
+			m->fetch_add (c, std::memory_order_relaxed); });
+		return moved.load (); }
+}
+
+	namespace detail
+	{
+		// Affine3::Apply through views; in may be out.
+		//
+		template <class U, class T> inline
+		void transform (Affine3<T> const& a, Vector3ViewT<U> const& in, Vector3ViewT<T> const& out, batch::Policy const& p) {
+			assert (out.Size () >= in.Size ());
+			if (in.Contiguous () && out.Contiguous ()) {transform (a, in.Vectors (), out.Vectors (), in.Size (), p); return;}
+			batch::For (in.Size (), p, [&] (size_t b, size_t e) {
+				Affine3<T> const k (a);
+				for (size_t i = b; i < e; ++i) {
+					T x = in[i].x, y = in[i].y, z = in[i].z;
+					out[i].x = k.a00*x + k.a01*y + k.a02*z + k.t0;
+					out[i].y = k.a10*x + k.a11*y + k.a12*z + k.t1;
+					out[i].z = k.a20*x + k.a21*y + k.a22*z + k.t2; } }); }
+	}
+
+	template <class U, class T> inline
+	void TransformPoints (Matrix4T<T> const& m, Vector3ViewT<U> const& in, Vector3ViewT<T> const& out, batch::Policy const& p = batch::Policy ()) {
+		VECTOR3_TIME (OpTransformPoints, in.Size ());
+		detail::transform (detail::Affine3<T> (m, true), in, out, p); }
+
+	template <class U, class T> inline
+	void TransformDirections (Matrix4T<T> const& m, Vector3ViewT<U> const& in, Vector3ViewT<T> const& out, batch::Policy const& p = batch::Policy ()) {
+		VECTOR3_TIME (OpTransformDirections, in.Size ());
+		detail::transform (detail::Affine3<T> (m, false), in, out, p); }
+
+	template <class U, class T> inline
+	void TransformDirections (Matrix3T<T> const& m, Vector3ViewT<U> const& in, Vector3ViewT<T> const& out, batch::Policy const& p = batch::Policy ()) {
+		VECTOR3_TIME (OpTransformDirections, in.Size ());
+		detail::transform (detail::Affine3<T> (m), in, out, p); }
+
+	template <class U, class T> inline
+	void Rotate (QuaternionT<T> const& q, Vector3ViewT<U> const& in, Vector3ViewT<T> const& out, batch::Policy const& p = batch::Policy ()) {
+		VECTOR3_TIME (OpRotate, in.Size ());
+		detail::transform (detail::Affine3<T> (q.ToMatrix ()), in, out, p); }
+
+	namespace detail
+	{
+		// sum_pairwise through a view.
+		//
+		template <class U> inline
+		Vector3T<typename Vector3ViewT<U>::Scalar> sum_pairwise (Vector3ViewT<U> const& v) {
+			typedef typename Vector3ViewT<U>::Scalar T;
+			size_t const n = v.Size ();
+			if (n > ReduceBlock) {
+				Vector3T<T> s = sum_pairwise (v.Sub (0, n / 2));
+				s += sum_pairwise (v.Sub (n / 2, n));
+				return s; }
+			Vector3T<T> a(T(0)), b(T(0)), c(T(0)), d(T(0));
+			size_t i = 0;
+			for (; i + 4 <= n; i += 4) {a += v[i]; b += v[i+1]; c += v[i+2]; d += v[i+3];}
+			for (; i < n; ++i) a += v[i];
+			a += b; c += d; a += c;
+			return a; }
+	}
+
+	// Reductions (Vector3Reduce.h) over views.
+	//
+	template <class U> inline
+	Vector3T<typename Vector3ViewT<U>::Scalar> Sum (Vector3ViewT<U> const& v, batch::Policy const& p = batch::Policy (), Arena* scratch = 0) {
+		typedef typename Vector3ViewT<U>::Scalar T;
+		if (v.Contiguous ()) return Sum (v.Vectors (), v.Size (), p, scratch);
+		VECTOR3_TIME (OpSum, v.Size ());
+		if (!p.pool && !p.parUnseq) return detail::sum_pairwise (v);
+		detail::Partials<Vector3T<T> > partial (v.Size (), p, scratch, [=] (size_t b, size_t e) {
+			return detail::sum_pairwise (v.Sub (b, e)); });
+		return detail::sum_pairwise (partial.data, partial.size); }
+
+	template <class U> inline
+	Vector3T<typename Vector3ViewT<U>::Scalar> Centroid (Vector3ViewT<U> const& v, batch::Policy const& p = batch::Policy (), Arena* scratch = 0) {
+		typedef typename Vector3ViewT<U>::Scalar T;
+		if (v.Empty ()) return Zero<T> ();
+		return Sum (v, p, scratch) / T(v.Size ()); }
+
+	template <class U> inline
+	Box3T<typename Vector3ViewT<U>::Scalar> Bounds (Vector3ViewT<U> const& v, batch::Policy const& p = batch::Policy (), Arena* scratch = 0) {
+		typedef typename Vector3ViewT<U>::Scalar T;
+		if (v.Contiguous ()) return Bounds (v.Vectors (), v.Size (), p, scratch);
+		VECTOR3_TIME (OpBounds, v.Size ());
+		auto leaf = [=] (size_t b, size_t e) {
+			Box3T<T> box = Box3T<T>::Empty ();
+			for (size_t i = b; i < e; ++i) box.Extend (v[i]);
+			return box; };
+		if (!p.pool && !p.parUnseq) return leaf (0, v.Size ());
+		detail::Partials<Box3T<T> > partial (v.Size (), p, scratch, leaf);
+		Box3T<T> box = Box3T<T>::Empty ();
+		for (size_t i = 0; i < partial.size; ++i) box.Extend (partial.data[i]);
+		return box; }
+
+	template <class U> inline
+	std::pair<typename Vector3ViewT<U>::Scalar, typename Vector3ViewT<U>::Scalar>
+	MinMaxLengthSq (Vector3ViewT<U> const& v, batch::Policy const& p = batch::Policy (), Arena* scratch = 0) {
+		typedef typename Vector3ViewT<U>::Scalar T;
+		typedef std::pair<T, T> Range;
+		if (v.Contiguous ()) return MinMaxLengthSq (v.Vectors (), v.Size (), p, scratch);
+		VECTOR3_TIME (OpMinMaxLengthSq, v.Size ());
+		auto leaf = [=] (size_t b, size_t e) {
+			T lo = std::numeric_limits<T>::max (), hi = T(0);
+			for (size_t i = b; i < e; ++i) {
+				T m = v[i].LengthSq ();
+				lo = m < lo ? m : lo; hi = m > hi ? m : hi; }
+			return Range (lo, hi); };
+		if (!p.pool && !p.parUnseq) return leaf (0, v.Size ());
+		detail::Partials<Range> partial (v.Size (), p, scratch, leaf);
+		Range r (std::numeric_limits<T>::max (), T(0));
+		for (size_t i = 0; i < partial.size; ++i) {
+			r.first = partial.data[i].first < r.first ? partial.data[i].first : r.first;
+			r.second = partial.data[i].second > r.second ? partial.data[i].second : r.second; }
+		return r; }
+
+namespace batch
+{
+	// Spatial keys and ordering (SpatialSort.h) over views.
+	//
+	template <class U, class T> inline
+	void MortonKeys (Vector3ViewT<U> const& v, Box3T<T> const& box, uint64_t* keys, Policy const& p = Policy ()) {
+		if (v.Contiguous ()) {MortonKeys (v.Vectors (), v.Size (), box, keys, p); return;}
+		Vec::detail::key_grid<T> const g (box);
+		For (v.Size (), p, [=, &g] (size_t b, size_t e) {
+			for (size_t i = b; i < e; ++i) {
+				uint32_t x, y, z; g (v[i], x, y, z);
+				keys[i] = MortonEncode (x, y, z); } }); }
+
+	template <class U, class T> inline
+	void HilbertKeys (Vector3ViewT<U> const& v, Box3T<T> const& box, uint64_t* keys, Policy const& p = Policy ()) {
+		if (v.Contiguous ()) {HilbertKeys (v.Vectors (), v.Size (), box, keys, p); return;}
+		Vec::detail::key_grid<T> const g (box);
+		For (v.Size (), p, [=, &g] (size_t b, size_t e) {
+			for (size_t i = b; i < e; ++i) {
+				uint32_t x, y, z; g (v[i], x, y, z);
+				keys[i] = HilbertEncode (x, y, z); } }); }
+
+	// out[i] = in[order[i]] for the in.Size () elements; out may not alias in.
+	//
+	template <class U, class T> inline
+	void Permute (Vector3ViewT<U> const& in, size_t const* order, Vector3ViewT<T> const& out, Policy const& p = Policy ()) {
+		assert (out.Size () >= in.Size ());
+		if (in.Contiguous () && out.Contiguous ()) {Permute (in.Vectors (), order, in.Size (), out.Vectors (), p); return;}
+		For (in.Size (), p, [=] (size_t b, size_t e) {
+			for (size_t i = b; i < e; ++i) out[i] = in[order[i]]; }); }
+
+	template <class T> inline
+	void SpatialSort (Vector3ViewT<T> const& v, size_t* order = 0, Curve curve = CurveHilbert, Policy const& p = Policy (), Arena* scratch = 0) {
+		size_t const n = v.Size ();
+		if (v.Contiguous ()) {SpatialSort (v.Vectors (), n, order, curve, p, scratch); return;}
+		if (n == 0) return;
+		Box3T<T> const box = Vec::Bounds (v, p, scratch);
+		detail::buffer<uint64_t> keys (n, scratch);
+		detail::buffer<size_t> own (order ? 0 : n, scratch);
+		size_t* const o = order ? order : own.data;
+		if (curve == CurveMorton) MortonKeys (v, box, keys.data, p);
+		else HilbertKeys (v, box, keys.data, p);
+		SortByKey (keys.data, n, o, p, scratch);
+		detail::buffer<Vector3T<T> > copy (n, scratch);
+		Vector3T<T>* const c = copy.data;
+		For (n, p, [=] (size_t b, size_t e) {for (size_t i = b; i < e; ++i) c[i] = v[i];});
+		Permute (Vec::View (c, n), o, v, p); }
+}
+}
+
+#endif // VECTOR3_VIEW_H
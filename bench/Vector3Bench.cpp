@@ -0,0 +1,241 @@
+// ************************************************************************************
+// Vector3Bench - Microbenchmarks of the Vector3 operations and batch kernels.
+//
+// Every case runs over working sets sized for L1, L2, L3 and DRAM, in float
+// and double, and reports nanoseconds per element and the bandwidth of the
+// bytes it reads and writes. Scalar operations loop over AoS arrays; batch
+// kernels run on AoS, Vector3A and SoA data so the layouts can be compared.
+// Only the headers are needed:
+//
+//   g++ -std=c++11 -O2 -pthread -I.. Vector3Bench.cpp -o Vector3Bench
+//   ./Vector3Bench [filter] [-t seconds]
+//
+// filter keeps the cases whose name contains it; -t sets the minimum time
+// per case (default 0.05 s). Every new kernel gets a line in the cases table.
+//
+// ************************************************************************************
+//
+#include <cstddef> // size_t
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Vector3.h"
+#include "Vector3SoA.h"
+#include "Vector3A.h"
+#include "Vector3Batch.h"
+#include "Vector3Reduce.h"
+#include "Vector3Dispatch.h"
+#include "Vector3Packed.h"
+#include "CachedVector3.h"
+#include "Matrix4.h"
+#include "Transform.h"
+#include "Intersect.h"
+#include "Predicates.h"
+#include "SpatialSort.h"
+#include "Vector3View.h"
+
+namespace
+{
+	// Keeps the compiler from discarding results it can see are unused.
+	//
+	template <class T> inline void Escape (T const* p) {
+#if defined(__GNUC__) || defined(__clang__)
+		asm volatile ("" : : "g" (p) : "memory");
+#else
+		static T const* volatile sink; sink = p;
+#endif
+	}
+
+	struct Options
+	{
+		std::string filter;
+		double seconds;
+	};
+
+	// Working sets: name and total bytes of the arrays a case touches.
+	//
+	struct Level {char const* name; size_t bytes;};
+	Level const Levels[] = {{"L1", 16 << 10}, {"L2", 256 << 10}, {"L3", 4 << 20}, {"DRAM", 128 << 20}};
+
+	// One benchmark: fn processes n elements, each reading and writing
+	// bytes bytes. Cases that work in place do so on a copy of the inputs
+	// that reset, run before the case is timed, refills; the shared inputs
+	// stay the same for every case.
+	//
+	struct Case
+	{
+		Case (char const* name, size_t bytes, std::function<void ()> const& fn, std::function<void ()> const& reset = std::function<void ()> ())
+			: name(name), bytes(bytes), fn(fn), reset(reset) {}
+
+		char const* name;
+		size_t bytes;
+		std::function<void ()> fn, reset;
+	};
+
+	void Report (Case const& c, char const* type, char const* level, size_t n, Options const& o) {
+		typedef std::chrono::steady_clock Clock;
+		if (c.reset) c.reset ();
+		c.fn ();
+		size_t reps = 1;
+		double elapsed = 0;
+		for (;;) {
+			Clock::time_point t0 = Clock::now ();
+			for (size_t r = 0; r < reps; ++r) c.fn ();
+			elapsed = std::chrono::duration<double> (Clock::now () - t0).count ();
+			if (elapsed >= o.seconds) break;
+			reps *= 2; }
+		double ns = elapsed * 1e9 / double (reps * n);
+		std::printf ("%-24s %-6s %-5s %10.3f ns/elem %9.2f GB/s\n", c.name, type, level, ns, double (c.bytes) / ns);
+		std::fflush (stdout); }
+
+	template <class T>
+	void Run (char const* type, Options const& o) {
+		typedef Vec::Vector3T<T> V;
+		typedef Vec::Vector3AT<T> VA;
+		size_t const VS = sizeof (V), S = sizeof (T);
+
+		for (size_t l = 0; l < sizeof Levels / sizeof Levels[0]; ++l) {
+			// Two inputs and one output of vectors is the largest case.
+			size_t const n = Levels[l].bytes / (3 * VS);
+			std::vector<V> a (n), b (n), out (n);
+			std::vector<VA> aa (n), ba (n), oa (n);
+			std::vector<T> s (n);
+			std::vector<char> flags (n);
+			std::vector<uint8_t> mask (n);
+			std::vector<Vec::Fixed16x3> fixed (n);
+			std::vector<Vec::Oct32> oct (n);
+			std::vector<Vec::Half3> half (n);
+			std::vector<Vec::CachedVector3T<T> > cached (n);
+			std::vector<Vec::Point2D> pts (n);
+			std::mt19937 rng (1);
+			std::uniform_real_distribution<T> u (T(-10), T(10));
+			for (size_t i = 0; i < n; ++i) {
+				a[i] = V (u (rng), u (rng), u (rng)); b[i] = V (u (rng), u (rng), u (rng));
+				aa[i] = VA (a[i]); ba[i] = VA (b[i]); cached[i] = a[i]; }
+			Vec::Vector3SoAT<T> sa, sb, so;
+			sa.FromAoS (a.data (), n); sb.FromAoS (b.data (), n); so.Resize (n);
+			Vec::TrianglesSoAT<T> tri;
+			tri.v0 = sa; tri.e1 = sb; tri.e2.FromAoS (a.data (), n); Vec::Normalize (tri.e2);
+			Vec::RayT<T> const ray (V (T(0)), Vec::Unit (V (T(1), T(2), T(3))));
+			Vec::PlaneT<T> const plane (Vec::Unit (V (T(1), T(1), T(0))), T(1));
+			Vec::Matrix4T<T> const m = Vec::Matrix4T<T>::Rotation (Vec::Unit (V (T(1), T(2), T(3))), T(0.5)) * Vec::Matrix4T<T>::Translation (V (T(1)));
+			T const k = T(1.5);
+			V* const pa = a.data (); V* const pb = b.data (); V* const po = out.data ();
+			VA* const qa = aa.data (); VA* const qb = ba.data (); VA* const qo = oa.data ();
+			T* const ps = s.data (); char* const pf = flags.data (); Vec::Point2D* const pp = pts.data ();
+			uint8_t* const pm = mask.data ();
+			std::vector<uint64_t> keys (n), sorted (n);
+			std::vector<size_t> order (n);
+			uint64_t* const pk = keys.data (); uint64_t* const pks = sorted.data (); size_t* const pi = order.data ();
+			Vec::Box3T<T> const box = Vec::Bounds (pa, n);
+			Vec::batch::HilbertKeys (pa, n, box, pk);
+			Vec::Fixed16x3* const pq = fixed.data (); Vec::Oct32* const pn = oct.data (); Vec::Half3* const ph = half.data ();
+			Vec::CachedVector3T<T> const* const pc = cached.data ();
+			std::vector<T> wide (4 * n); // a, one padding scalar per vector
+			for (size_t i = 0; i < n; ++i) {wide[4*i] = a[i].x; wide[4*i+1] = a[i].y; wide[4*i+2] = a[i].z;}
+			Vec::Vector3ViewT<T> const pw = Vec::View (wide.data (), n, 4);
+			// Copies the in-place cases work on.
+			std::vector<V> work (n);
+			std::vector<T> wideWork (4 * n);
+			Vec::Vector3SoAT<T> soaWork;
+			V* const pv = work.data ();
+			Vec::Vector3ViewT<T> const pwv = Vec::View (wideWork.data (), n, 4);
+			auto const resetA = [=] {std::memcpy (pv, pa, n * VS);};
+			auto const resetB = [=] {std::memcpy (pv, pb, n * VS);};
+			auto const resetWide = [&] {wideWork = wide;};
+			auto const resetSoA = [&] {soaWork = sa;};
+			auto const resetSoB = [&] {soaWork = sb;};
+			Vec::QuantizerT<T> const quant (Vec::Box3T<T> (V (T(-10)), V (T(10))));
+
+			Case const cases[] = {
+				// Vector3 operators and Vec functions, one vector at a time.
+				{"operator+", 3*VS, [=] {for (size_t i = 0; i < n; ++i) po[i] = pa[i] + pb[i]; Escape (po);}},
+				{"operator-", 3*VS, [=] {for (size_t i = 0; i < n; ++i) po[i] = pa[i] - pb[i]; Escape (po);}},
+				{"operator*(scalar)", 2*VS, [=] {for (size_t i = 0; i < n; ++i) po[i] = pa[i] * k; Escape (po);}},
+				{"operator/(scalar)", 2*VS, [=] {for (size_t i = 0; i < n; ++i) po[i] = pa[i] / k; Escape (po);}},
+				{"operator-(unary)", 2*VS, [=] {for (size_t i = 0; i < n; ++i) po[i] = -pa[i]; Escape (po);}},
+				{"operator*(dot)", 2*VS + S, [=] {for (size_t i = 0; i < n; ++i) ps[i] = pa[i] * pb[i]; Escape (ps);}},
+				{"operator==", 2*VS + 1, [=] {for (size_t i = 0; i < n; ++i) pf[i] = pa[i] == pb[i]; Escape (pf);}},
+				{"Dot", 2*VS + S, [=] {for (size_t i = 0; i < n; ++i) ps[i] = Vec::Dot (pa[i], pb[i]); Escape (ps);}},
+				{"Cross", 3*VS, [=] {for (size_t i = 0; i < n; ++i) po[i] = Vec::Cross (pa[i], pb[i]); Escape (po);}},
+				{"Unit", 2*VS, [=] {for (size_t i = 0; i < n; ++i) po[i] = Vec::Unit (pa[i]); Escape (po);}},
+				{"UnitFast", 2*VS, [=] {for (size_t i = 0; i < n; ++i) po[i] = Vec::UnitFast (pa[i]); Escape (po);}},
+				{"Length", VS + S, [=] {for (size_t i = 0; i < n; ++i) ps[i] = pa[i].Length (); Escape (ps);}},
+				{"CachedVector3 Length", sizeof (Vec::CachedVector3T<T>) + S, [=] {for (size_t i = 0; i < n; ++i) ps[i] = pc[i].Length (); Escape (ps);}},
+				{"Distance", 2*VS + S, [=] {for (size_t i = 0; i < n; ++i) ps[i] = Vec::Distance (pa[i], pb[i]); Escape (ps);}},
+				{"Area", 2*VS + S, [=] {for (size_t i = 0; i < n; ++i) ps[i] = Vec::Area (pa[i], pb[i]); Escape (ps);}},
+				{"is_equal", 2*VS + 1, [=] {for (size_t i = 0; i < n; ++i) pf[i] = Vec::is_equal (pa[i], pb[i]); Escape (pf);}},
+				{"NearlyEqual", 2*VS + 1, [=] {for (size_t i = 0; i < n; ++i) pf[i] = Vec::NearlyEqual (pa[i], pb[i], T(1e-6), T(1e-5)); Escape (pf);}},
+				{"UlpEqual", 2*VS + 1, [=] {for (size_t i = 0; i < n; ++i) pf[i] = Vec::UlpEqual (pa[i], pb[i], 4); Escape (pf);}},
+				{"Dot(Cross) orientation", 4*VS + S, [=] {for (size_t i = 0; i < n; ++i) ps[i] = Vec::Dot (pa[i] - pb[n-1-i], Vec::Cross (pb[i] - pb[n-1-i], pa[n-1-i] - pb[n-1-i])); Escape (ps);}},
+				{"Orient3D", 4*VS + S, [=] {for (size_t i = 0; i < n; ++i) ps[i] = T (Vec::Orient3D (pa[i], pb[i], pa[n-1-i], pb[n-1-i])); Escape (ps);}},
+				{"InSphere", 5*VS + S, [=] {for (size_t i = 0; i < n; ++i) ps[i] = T (Vec::InSphere (pa[i], pb[i], pa[n-1-i], pb[n-1-i], pa[i/2])); Escape (ps);}},
+				{"to_point2d", VS + 8, [=] {for (size_t i = 0; i < n; ++i) pp[i] = Vec::to_point2d (pa[i]); Escape (pp);}},
+
+				// The same on Vector3A.
+				{"Vector3A Dot", 8*S + S, [=] {for (size_t i = 0; i < n; ++i) ps[i] = Vec::Dot (qa[i], qb[i]); Escape (ps);}},
+				{"Vector3A Cross", 12*S, [=] {for (size_t i = 0; i < n; ++i) qo[i] = Vec::Cross (qa[i], qb[i]); Escape (qo);}},
+				{"Vector3A Unit", 8*S, [=] {for (size_t i = 0; i < n; ++i) qo[i] = Vec::Unit (qa[i]); Escape (qo);}},
+
+				// Batch kernels over AoS arrays.
+				{"batch::Normalize", 2*VS, [=] {Vec::batch::Normalize (pv, n); Escape (pv);}, resetA},
+				{"batch::NormalizeFast", 2*VS, [=] {Vec::batch::NormalizeFast (pv, n); Escape (pv);}, resetA},
+				{"batch::Unit", 2*VS, [=] {Vec::batch::Unit (pa, n, po); Escape (po);}},
+				{"batch::Distance", VS + S, [=] {Vec::batch::Distance (pa, n, pb[0], ps); Escape (ps);}},
+				{"batch::Dot", 2*VS + S, [=] {Vec::batch::Dot (pa, pb, n, ps); Escape (ps);}},
+				{"batch::Axpy", 3*VS, [=] {Vec::batch::Axpy (T(1e-3), pa, pv, n); Escape (pv);}, resetB},
+				{"batch::ToPoint2D", VS + 8, [=] {Vec::batch::ToPoint2D (pa, n, pp); Escape (pp);}},
+				{"batch::NearlyEqual", 2*VS + 1, [=] {Vec::batch::NearlyEqual (pa, pb, n, T(1e-6), T(1e-5), pm); Escape (pm);}},
+				{"batch::Moved", 2*VS + 1, [=] {size_t c = Vec::batch::Moved (pa, pb, n, T(1), pm); Escape (&c);}},
+				{"batch::Pack(Fixed16x3)", VS + 6, [=, &quant] {Vec::batch::Pack (pa, n, quant, pq); Escape (pq);}},
+				{"batch::Unpack(Fixed16x3)", VS + 6, [=, &quant] {Vec::batch::Unpack (pq, n, quant, po); Escape (po);}},
+				{"batch::Pack(Oct32)", VS + 4, [=] {Vec::batch::Pack (pa, n, pn); Escape (pn);}},
+				{"batch::Unpack(Oct32)", VS + 4, [=] {Vec::batch::Unpack (pn, n, po); Escape (po);}},
+				{"batch::Pack(Half3)", VS + 6, [=] {Vec::batch::Pack (pa, n, ph); Escape (ph);}},
+				{"batch::Unpack(Half3)", VS + 6, [=] {Vec::batch::Unpack (ph, n, po); Escape (po);}},
+				{"batch::MortonKeys", VS + 8, [=] {Vec::batch::MortonKeys (pa, n, box, pks); Escape (pks);}},
+				{"batch::HilbertKeys", VS + 8, [=] {Vec::batch::HilbertKeys (pa, n, box, pks); Escape (pks);}},
+				{"batch::SortByKey", 2*8 + 8, [=] {std::memcpy (pks, pk, n * 8); Vec::batch::SortByKey (pks, n, pi); Escape (pi);}},
+				{"batch::Permute", 2*VS + 8, [=] {Vec::batch::Permute (pa, pi, n, po); Escape (po);}},
+				{"View(stride 4) batch::Normalize", 2*4*S, [=] {Vec::batch::Normalize (pwv); Escape (pwv.Data ());}, resetWide},
+				{"View(stride 4) batch::Dot", 4*S + VS + S, [=] {Vec::batch::Dot (pw, Vec::View (pb, n), ps); Escape (ps);}},
+				{"View(stride 4) TransformPoints", 2*4*S, [=] {Vec::TransformPoints (m, pwv, pwv); Escape (pwv.Data ());}, resetWide},
+				{"Sum", VS, [=] {V r = Vec::Sum (pa, n); Escape (&r);}},
+				{"Bounds", VS, [=] {Vec::Box3T<T> r = Vec::Bounds (pa, n); Escape (&r);}},
+				{"TransformPoints", 2*VS, [=] {Vec::TransformPoints (m, pa, po, n); Escape (po);}},
+
+				// Batch kernels over SoA streams.
+				{"SoA Dot", 2*VS + S, [&] {Vec::Dot (sa, sb, ps); Escape (ps);}},
+				{"SoA Cross", 3*VS, [&] {Vec::Cross (sa, sb, so); Escape (so.X ());}},
+				{"SoA Normalize", 2*VS, [&] {Vec::Normalize (soaWork); Escape (soaWork.X ());}, resetSoA},
+				{"SoA NormalizeFast", 2*VS, [&] {Vec::NormalizeFast (soaWork); Escape (soaWork.X ());}, resetSoA},
+				{"SoA Distance", 2*VS + S, [&] {Vec::Distance (sa, sb, ps); Escape (ps);}},
+				{"SoA Axpy", 3*VS, [&] {Vec::Axpy (T(1e-3), sa, soaWork); Escape (soaWork.X ());}, resetSoB},
+				{"SoA TransformPoints", 2*VS, [&] {Vec::TransformPoints (m, sa, so); Escape (so.X ());}},
+				{"SoA Intersect(ray)", 9*S + S + 1, [&] {size_t c = Vec::Intersect (ray, tri, ps, pm); Escape (&c);}},
+				{"SoA SignedDistance", VS + S + 1, [&] {size_t c = Vec::SignedDistance (plane, sa, ps, pm); Escape (&c);}},
+				{"SoA SegmentDistanceSq", VS + S + 1, [&] {size_t c = Vec::SegmentDistanceSq (sa, pa[0], pb[0], ps, pm, T(2)); Escape (&c);}},
+				{"dispatch::Dot", 2*VS + S, [&] {Vec::dispatch::Dot (sa, sb, ps); Escape (ps);}},
+				{"dispatch::Normalize", 2*VS, [&] {Vec::dispatch::Normalize (soaWork); Escape (soaWork.X ());}, resetSoA},
+			};
+			for (size_t c = 0; c < sizeof cases / sizeof cases[0]; ++c)
+				if (o.filter.empty () || std::strstr (cases[c].name, o.filter.c_str ()))
+					Report (cases[c], type, Levels[l].name, n, o); } }
+}
+
+int main (int argc, char** argv) {
+	Options o;
+	o.seconds = 0.05;
+	for (int i = 1; i < argc; ++i) {
+		if (!std::strcmp (argv[i], "-t") && i + 1 < argc) o.seconds = std::atof (argv[++i]);
+		else o.filter = argv[i]; }
+	std::printf ("dispatch level: %s\n", Vec::dispatch::Name (Vec::dispatch::Kernels<float> ().level));
+	Run<float> ("float", o);
+	Run<double> ("double", o);
+	return 0; }